@@ -0,0 +1,77 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_AGENT_HH
+#define FOURCRYPT_AGENT_HH
+
+// Local
+#include "Core.hh"
+// C++ STL
+#include <string>
+
+namespace fourcrypt
+ {
+  /* The client side of 4crypt-agent, which keeps KDF outputs in locked memory for a while, so that
+   * opening the same file again skips the KDF.
+   *
+   * Entries are keyed by a Skein512 digest of the salt, the KDF parameters and the password, so the
+   * agent never learns the password, and a wrong password misses rather than yielding a key.
+   * Each side checks that the other runs as the same user before exchanging anything. Every
+   * failure, including a missing or unresponsive agent, is treated as a cache miss.
+   */
+  class Agent
+   {
+   public:
+    static constexpr size_t   DIGEST_BYTES {64};
+    static constexpr size_t   VALUE_BYTES  {64}; // TSC_KDF_OUTPUT_BYTES
+    static constexpr uint8_t  PROTOCOL_VERSION {1};
+    static constexpr unsigned TIMEOUT_MILLISECONDS {1000};
+    static constexpr unsigned DEFAULT_TTL_SECONDS {600};
+    enum class Op : uint8_t
+     {
+      LOOKUP = 1, STORE = 2, CLEAR = 3
+     };
+    // Every request and reply has a fixed size; unused fields are zero.
+    struct Request
+     {
+      uint8_t version;
+      Op      op;
+      uint8_t digest [DIGEST_BYTES];
+      uint8_t value  [VALUE_BYTES];
+     };
+    struct Reply
+     {
+      uint8_t found;
+      uint8_t value [VALUE_BYTES];
+     };
+
+    /* Return the path of the agent's socket: $FOURCRYPT_AGENT_SOCK if set, otherwise
+     * local_socket_path("agent"). */
+    static std::string socketPath(void);
+    /* Compute the cache key of the KDF @pod is about to run into @out. */
+    static void digest(const Core::PlainOldData& pod, uint8_t* out);
+    /* Copy the cached output of the KDF @pod is about to run to @out and return true.
+     * Return false if it isn't cached. */
+    static bool lookup(const Core::PlainOldData& pod, uint8_t* out);
+    /* Offer the agent @value, the output of the KDF @pod just ran. */
+    static void store(const Core::PlainOldData& pod, const uint8_t* value);
+    /* Ask the agent to wipe every entry. Return false if no agent answered. */
+    static bool clear(void);
+   private:
+    static bool transact(const Request& req, Reply* reply);
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,86 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_ASYNC_HH
+#define FOURCRYPT_ASYNC_HH
+
+// Local
+#include "Core.hh"
+#include "Executor.hh"
+#include "Session.hh"
+// C++ STL
+#include <coroutine>
+#include <span>
+
+namespace fourcrypt
+ {
+  /* An awaitable Session job. co_await-ing it suspends the awaiting coroutine, runs the job (KDF, cipher and MAC
+   * included) on an Executor's worker thread, and resumes the coroutine with the Session::Result once the
+   * job is done. No thread of the caller's is blocked meanwhile, and jobs beyond the executor's thread count
+   * wait in its queue rather than on threads of their own. The job blocks its worker throughout, so the
+   * default is Executor::jobs(); its counter mode tiles still run on Executor::global().
+   *
+   * By default the coroutine resumes on the worker thread. Event loops should pass a @resume function that
+   * posts the handle to the loop instead, e.g. through g_idle_add() or asio::post().
+   *
+   *   AsyncOperation op {session, job};
+   *   Session::Result r {co_await op};
+   *
+   * progress() and cancel() may be called from any thread while the operation is pending. The operation
+   * must outlive the co_await, and each operation may be awaited once.
+   */
+  class AsyncOperation
+   {
+   public:
+    using Resume_f = void(std::coroutine_handle<> handle, void* data);
+
+    /* Run @job between files, see Session::run(). @job is copied. */
+    AsyncOperation(Session& session, const Session::Job& job, Executor& executor = Executor::jobs(),
+                   Resume_f* resume = nullptr, void* resume_data = nullptr);
+    /* Run @job from @input into @output, see Session::runBuffer(). @job is copied; the buffers must outlive the operation. */
+    AsyncOperation(Session& session, const Session::Job& job, std::span<uint8_t> output, std::span<const uint8_t> input,
+                   Executor& executor = Executor::jobs(), Resume_f* resume = nullptr, void* resume_data = nullptr);
+    AsyncOperation(const AsyncOperation&) = delete;
+    AsyncOperation& operator=(const AsyncOperation&) = delete;
+
+    bool            await_ready(void) const noexcept { return false; }
+    void            await_suspend(std::coroutine_handle<> handle);
+    Session::Result await_resume(void) const noexcept { return this->result; }
+
+    /* Ask the operation to stop; it then completes with Core::ERROR_CANCELLED unless it finishes first. */
+    void            cancel(void);
+    Core::Progress  progress(void);
+    /* The size of the output of a buffer operation, once it completed successfully. */
+    uint64_t        outputSize(void) const { return this->output_size; }
+   private:
+    Session*                 session;
+    Session::Job             job;
+    Executor*                executor;
+    Resume_f*                resume;
+    void*                    resume_data;
+    std::span<uint8_t>       output {};
+    std::span<const uint8_t> input  {};
+    bool                     is_buffer {false};
+    uint64_t                 output_size {0};
+    Core                     core {};
+    Session::Result          result {};
+    Core::CancelToken        cancel_token {};
+
+    /* Execute the job on a worker thread, then resume @handle. */
+    void        execute(std::coroutine_handle<> handle);
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,99 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_BENCH_HH
+#define FOURCRYPT_BENCH_HH
+
+// Local
+#include "Core.hh"
+// C++ STL
+#include <string>
+#include <vector>
+// C++ C Lib
+#include <cstdio>
+
+namespace fourcrypt
+ {
+  /* The 4crypt-bench harness. Each benchmark is timed over a number of warmup runs that are discarded
+   * and a number of repeats that are summarized; very short operations are batched so that each
+   * repeat lasts at least MIN_SAMPLE_SECONDS. Results are printed as JSON, for tracking across releases.
+   */
+  class Bench
+   {
+   public:
+    static constexpr int    VERSION            {1};
+    static constexpr double MIN_SAMPLE_SECONDS {1e-3};
+    static constexpr int    EXIT_SKIPPED       {77}; // No baseline to compare against; ctest's SKIP_RETURN_CODE.
+
+    struct Options
+     {
+      std::vector<std::string> dirs;                        // Directories for end-to-end runs.
+      std::string              filter;                      // Only run benchmarks whose name contains this.
+      std::string              output;                      // Write JSON here rather than to stdout.
+      std::string              baseline;                    // Compare against the JSON results at this path.
+      double                   tolerance {0.10};            // Allowed relative regression against @baseline.
+      uint64_t                 file_size {UINT64_C(64) << 20}; // Size of the end-to-end input files.
+      int                      warmup    {2};
+      int                      repeats   {15};
+      bool                     quick     {false};           // Fewer sizes, presets and repeats.
+     };
+    // Seconds per operation over the repeats.
+    struct Summary
+     {
+      double min    {0.0};
+      double median {0.0};
+      double p90    {0.0};
+      double p99    {0.0};
+      double mean   {0.0};
+     };
+    struct Result
+     {
+      std::string name;                   // e.g. "ctr/xor/65536".
+      std::string group;                  // "ctr", "mac", "header", "kdf" or "e2e".
+      uint64_t    bytes            {0};   // Bytes processed per operation; 0 if not meaningful.
+      int         samples          {0};
+      Summary     seconds          {};
+      const char* metric           {""};  // The figure to track: "mib_per_s", "ns" or "seconds_per_gib".
+      double      value            {0.0}; // The metric, derived from the median.
+      bool        higher_is_better {true};
+     };
+
+    explicit Bench(const Options& opt);
+    /* Run every selected benchmark, reporting each to stderr as it finishes. */
+    void run(void);
+    /* Print all results as a JSON document to @f. */
+    void print(std::FILE* f) const;
+    const std::vector<Result>& getResults(void) const;
+    /* Compare the results to the baseline previously written by print() to @path, reporting each
+     * comparison to @report. A result regresses when its metric is worse than the baseline's by more
+     * than @tolerance (e.g. 0.10 for 10%); results absent from the baseline are not compared.
+     * Return the number of regressions, or -1 if the baseline cannot be read.
+     */
+    int  compare(const std::string& path, double tolerance, std::FILE* report) const;
+   private:
+    Options             options;
+    std::vector<Result> results;
+
+    bool selected(const std::string& name) const;
+    void record(Result&& r);
+    void benchCtr(void);
+    void benchMac(void);
+    void benchHeader(void);
+    void benchKdf(void);
+    void benchEndToEnd(void);
+   };
+ } // ! namespace fourcrypt
+#endif
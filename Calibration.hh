@@ -0,0 +1,78 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_CALIBRATION_HH
+#define FOURCRYPT_CALIBRATION_HH
+
+// Local
+#include "Core.hh"
+// C++ STL
+#include <string>
+
+namespace fourcrypt
+ {
+  /* A cost model of the key derivation function on this host, fitted from short probe runs:
+   *
+   *   seconds = overhead + rounds * seconds_per_byte * memory
+   *             * (1 + iteration_factor * (iterations - 1))
+   *             * (phi ? phi_factor : 1)
+   *             * concurrency(batch_size)
+   *
+   * where concurrency() interpolates the slowdown measured when @concurrency_threads
+   * threads contend for memory bandwidth at once.
+   */
+  class Calibration
+   {
+   public:
+    using Pod_t = Core::PlainOldData;
+    static constexpr int    VERSION               {2};
+    static constexpr double STRONG_TARGET_SECONDS {5.0};
+
+    double   overhead            {0.0}; // Fixed cost of one KDF invocation, in seconds.
+    double   seconds_per_byte    {0.0}; // Cost per byte of memory of one thread iterating once.
+    double   iteration_factor    {1.0}; // Relative cost of each iteration after the first.
+    double   phi_factor          {1.0}; // Relative cost of enabling the Phi function.
+    double   concurrency_factor  {1.0}; // Relative cost of running @concurrency_threads threads at once.
+    uint64_t concurrency_threads {1};
+    uint64_t processors          {1};   // How many usable processors were there when this was measured?
+    std::string cpu_model        {};    // Which processor model, per get_cpu_model()?
+    uint64_t memory_bytes        {0};   // How much physical memory did the host have?
+
+    /* Return the calibration for this host; loaded from the cache file when it is valid,
+     * otherwise measured and then stored to the cache file. */
+    static Calibration get(bool force_measure = false);
+    /* Time probe runs of the KDF and fit the cost model. This takes on the order of a second. */
+    static Calibration measure(void);
+    /* Return the path of this host's calibration cache file, or an empty string if there is none. */
+    static std::string cachePath(void);
+    /* Return how many bytes the KDF may use in total when the user hasn't said. */
+    static uint64_t    defaultMemoryBudget(void);
+
+    /* Load the calibration at @path. Fail if it is stale, or was measured on other hardware: a different
+     * number of usable processors, processor model or amount of physical memory. */
+    bool   load(const std::string& path);
+    bool   save(const std::string& path) const;
+    /* Predict how many seconds the KDF takes with the given parameters. */
+    double predict(uint8_t mem_bitshift, uint8_t iterations, uint64_t threads, uint64_t batch_size, bool phi) const;
+    /* Choose the memory bound, thread count and iteration count of @pod that maximize the
+     * KDF's area-time cost (threads * memory^2 * iterations) while the predicted time stays within
+     * @target_seconds and all concurrently executing threads fit within @max_memory bytes.
+     * Memory per thread is never chosen below @min_mem_bitshift. Phi usage is taken from @pod.
+     */
+    void   tune(Pod_t& pod, double target_seconds, uint64_t max_memory, uint8_t min_mem_bitshift = Core::MEM_FAST) const;
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -28,6 +28,10 @@ namespace fourcrypt {
 
 struct ArgProc
  {
+  // Pin the process-wide worker threads compactly or scattered across the processors.
+  static int affinity(ARGS_);
+  // Look up and cache KDF outputs in a running 4crypt-agent.
+  static int agent(ARGS_);
   // Set the number of KDF threads to process simultaneously.
   static int batch_size(ARGS_);
   // Set the mode to Decrypt, and provide the path to the encrypted file.
@@ -46,8 +50,14 @@ struct ArgProc
   static int high_mem(ARGS_);
   // Set the number of KDF iterations per thread.
   static int iterations(ARGS_);
+  // Enable or disable interleaving KDF memory across NUMA nodes.
+  static int numa(ARGS_);
   // Set the lower memory bound for the KDF.
   static int low_mem(ARGS_);
+  // Set the total memory the KDF may use when calibrating to a target time.
+  static int max_memory(ARGS_);
+  // Export counters and latency histograms in the Prometheus text format to the provided path on exit.
+  static int metrics(ARGS_);
   // Set the output file path.
   static int output(ARGS_);
   // Pad the output ciphertext as if it was an unpadded ciphertext of the provided size, rounded up to be divisible by 64.
@@ -56,12 +66,28 @@ struct ArgProc
   static int pad_by(ARGS_);
   // Pad the output ciphertext up to the provided target size in bytes, rounded up to be divisible by 64.
   static int pad_to(ARGS_);
+  // Report hardware performance counters per phase alongside the timing statistics.
+  static int profile(ARGS_);
+  // Print a progress line with throughput and estimated time remaining while executing.
+  static int progress(ARGS_);
+  // Choose KDF parameters that take the provided number of seconds on this host.
+  static int target_time(ARGS_);
+  // Print the memory and processors available to this process and exit successfully.
+  static int show_resources(ARGS_);
+  // Read and write input files up to the provided size whole, instead of memory-mapping them.
+  static int small_file_limit(ARGS_);
+  // Report per-phase timing and throughput after the operation, as text or JSON.
+  static int stats(ARGS_);
+  // Record a timeline of the operation and write it to the provided path in Chrome Trace Event format.
+  static int trace(ARGS_);
   // Set the number of KDF threads.
   static int threads(ARGS_);
   // Set the low and high KDF memory bounds to the same provided value.
   static int use_mem(ARGS_);
   // Enable usage of the Phi function in the KDF.
   static int use_phi(ARGS_);
+  // Set the mode to Verify, and provide the path to the encrypted file.
+  static int verify(ARGS_);
  };
 
 } // ! namespace fourcrypt
@@ -18,7 +18,15 @@
 #define FOURCRYPT_CORE_HH
 
 // C++ STL
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <span>
 #include <string>
+#include <vector>
 // SSC
 #include <SSC/Typedef.h>
 #include <SSC/Memory.h>
@@ -38,6 +46,10 @@
 
 namespace fourcrypt
  {
+  class Executor;
+  class MemoryBudget;
+  class Stats;
+
   class Core
    {
    public:
@@ -54,22 +66,58 @@ namespace fourcrypt
     static constexpr SSC_BitFlag8_t ENABLE_PHI         {0b00000001}; // Enable the Phi function.
     static constexpr SSC_BitFlag8_t SUPPLEMENT_ENTROPY {0b00000010}; // Supplement entropy from stdin.
     static constexpr SSC_BitFlag8_t ENTER_PASS_ONCE    {0b00000100}; // Don't re-enter password during encrypt.
+    static constexpr SSC_BitFlag8_t DISABLE_NUMA       {0b00001000}; // Don't interleave KDF memory across NUMA nodes.
+    static constexpr SSC_BitFlag8_t SHOW_PROGRESS      {0b00010000}; // Print a progress line while executing.
+    static constexpr SSC_BitFlag8_t PROFILE_COUNTERS   {0b00100000}; // Report performance counters per phase.
+    static constexpr SSC_BitFlag8_t USE_AGENT          {0b01000000}; // Look up and cache KDF outputs in 4crypt-agent.
     static constexpr uint8_t MEM_FAST    {21}; // 128 Mebibytes.
     static constexpr uint8_t MEM_NORMAL  {24}; // 1   Gibibyte.
     static constexpr uint8_t MEM_STRONG  {25}; // 2   Gibibytes.
     static constexpr uint8_t MEM_DEFAULT {MEM_NORMAL};
+    // The counter mode keystream is applied this many bytes at a time, and progress is published once per tile.
+    static constexpr uint64_t CTR_TILE_BYTES {UINT64_C(1) << 20};
+    static_assert(CTR_TILE_BYTES % TSC_THREEFISH512_BLOCK_BYTES == 0);
+    // Tiles applied in parallel are handed out this many per lane (workers plus the caller) between progress updates.
+    static constexpr uint64_t CTR_ROUND_TILES_PER_LANE {4};
+    /* encrypt() and decrypt() ask the kernel to read this much of the input ahead while the KDF runs;
+     * beyond it sequential readahead takes over, so that prefetching never competes with the KDF for
+     * more memory than this. */
+    static constexpr uint64_t PREFETCH_WINDOW_BYTES {UINT64_C(64) << 20};
+    // Input files up to this many bytes are read and written whole rather than memory-mapped, by default.
+    static constexpr uint64_t SMALL_FILE_LIMIT_DEFAULT {UINT64_C(1) << 20};
     static constexpr uint64_t memoryFromBitShift(uint8_t bitshift)
      {
       return static_cast<uint64_t>(1) << (bitshift + 6);
      }
   
+    /* TSC_kdf executes @thread_count KDF threads in rounds of @batch_size concurrent threads.
+     * Return the smallest batch size that still completes in the same number of rounds, so that the
+     * final round isn't left ragged while earlier rounds hold more memory than necessary.
+     * This saves memory, not time: the rounds, and the barrier at the end of each of them, are inside
+     * TSC_kdf, so a slow thread still holds up its whole round, and batch sizes that already divide
+     * evenly as far as they can (e.g. 10 threads in batches of 4) are left as they are.
+     */
+    static constexpr uint64_t balanceBatchSize(uint64_t thread_count, uint64_t batch_size)
+     {
+      if (thread_count == 0 || batch_size == 0)
+        return batch_size;
+      const uint64_t rounds {(thread_count + batch_size - 1) / batch_size};
+      return (thread_count + rounds - 1) / rounds;
+     }
+  
+    /* Keep at least this many bytes, or 1/PLAN_MARGIN_DIVISOR of the available memory (whichever
+     * is more) unclaimed when planning how many KDF threads to execute at once.
+     */
+    static constexpr uint64_t PLAN_MARGIN_MIN     {UINT64_C(256) * 1024 * 1024};
+    static constexpr uint64_t PLAN_MARGIN_DIVISOR {8};
+  
     static constexpr uint64_t PAD_FACTOR {64}; // Files will always be a multiple of 64 bytes.
     static constexpr uint64_t MAC_SIZE   {64}; // The Message Authentication Code is 64 bytes.
   
     // What does the user want the software to do?
     enum class ExeMode
      {
-      NONE, ENCRYPT, DECRYPT, DESCRIBE
+      NONE, ENCRYPT, DECRYPT, DESCRIBE, VERIFY
      };
     // How does the user want the padding they requested to be done?
     enum class PadMode
@@ -83,6 +131,17 @@ namespace fourcrypt
       INPUT  = 1,
       OUTPUT = 2
      };
+    // The distinct stages of encrypt() and decrypt(), roughly in order of execution.
+    // COUNT doubles as "no operation has begun yet".
+    enum class Phase
+     {
+      MAP_FILES, PASSWORD, RANDOM, KDF, HEADER, CIPHER, MAC, SYNC, UNMAP_FILES, COUNT
+     };
+    // How should reports, such as timing statistics, be formatted?
+    enum class ReportFormat
+     {
+      NONE, TEXT, JSON
+     };
     // Distinguish errors that happen inside Core logic from errors that happen inside SSC_MemMap procedure calls.
     enum class ErrType
      {
@@ -104,6 +163,9 @@ namespace fourcrypt
     static constexpr SSC_CodeError_t ERROR_MAC_VALIDATION_FAILED      {-11};
     static constexpr SSC_CodeError_t ERROR_KDF_FAILED                 {-12};
     static constexpr SSC_CodeError_t ERROR_METADATA_VALIDATION_FAILED {-13};
+    static constexpr SSC_CodeError_t ERROR_CANCELLED                  {-14};
+    static constexpr SSC_CodeError_t ERROR_BUFFER_TOO_SMALL           {-15};
+    static constexpr SSC_CodeError_t ERROR_INVALID_PADDING            {-16};
     struct PlainOldData
      {
       TSC_Threefish512Ctr         tf_ctr; // Threefish512 Cipher in Counter Mode.
@@ -130,8 +192,12 @@ namespace fourcrypt
       uint64_t                    padding_size;  // How many bytes of padding?
       uint64_t                    thread_count;  // How many KDF threads?
       uint64_t                    thread_batch_size; // How many KDF threads per batch? i.e. How many threads execute concurrently?
+      uint64_t                    max_memory;    // How many bytes may the KDF use in total when calibrating? 0 for the default.
+      uint64_t                    small_file_limit; // Read and write input files up to this many bytes whole instead of mapping them. 0 to always map.
+      double                      target_seconds; // Calibrate the KDF to take this many seconds, if greater than 0.
       ExeMode                     execute_mode;  // What shall we do? Encrypt? Decrypt? Describe?
       PadMode                     padding_mode;  // What context were the padding bytes specified for?
+      ReportFormat                stats_format;  // Report per-phase statistics in this format, if any.
       uint8_t                     memory_low;    // What is the lower memory bound of the KDF?
       uint8_t                     memory_high;   // What is the upper memory bound of the KDF?
       uint8_t                     iterations;    // How many times will each thread of the KDF iterate?
@@ -142,7 +208,70 @@ namespace fourcrypt
       static void touchup(PlainOldData& pod); // Ensure the values inside a PlainOldData object are valid & consistent.
       static void set_fast(PlainOldData& pod);
       static void set_normal(PlainOldData& pod);
-      static void set_strong(PlainOldData& pod); //TODO
+      static void set_strong(PlainOldData& pod);
+      static void set_calibrated(PlainOldData& pod); // Calibrate to @target_seconds and @max_memory.
+     };
+    /* Progress of the key derivation function, for callers that poll it from another thread
+     * while encrypt() or decrypt() is running. The KDF threads run inside TSC_kdf, which
+     * cannot be observed midway, so @lanes_done is coarse: it jumps from 0 to @lanes_total when
+     * TSC_kdf returns, and there are no per-layer counts. For a progress bar or an ETA use
+     * estimatedFraction() instead, which compares the time elapsed with the time predicted by
+     * this host's cached Calibration.
+     */
+    struct KdfProgress
+     {
+      std::atomic<uint64_t> lanes_total {0};     // How many KDF threads will execute?
+      std::atomic<uint64_t> lanes_done  {0};     // How many KDF threads have completed?
+      std::atomic<bool>     running     {false}; // Is the KDF executing right now?
+      std::atomic<int64_t>  started_ns  {0};     // When did the computation begin, in steady_clock nanoseconds? 0 if it hasn't.
+      std::atomic<double>   predicted_seconds {0.0}; // How long should it take? 0 when no calibration is cached.
+
+      /* Return how many seconds the computation has been running, or 0 if it hasn't begun. */
+      double elapsedSeconds() const;
+      /* Return the elapsed over the predicted time, capped at 0.99 until the KDF returns and 1 after;
+       * or -1 when there is no prediction. */
+      double estimatedFraction() const;
+     };
+    /* A request to stop an operation, which may be made from any thread. Operations check it between
+     * stages, before every CTR_TILE_BYTES tile of the counter mode passes and every CANCEL_POLL_MILLISECONDS
+     * while the KDF runs; then they fail with ERROR_CANCELLED, after wiping the keys, unmapping the files
+     * and deleting any output file they created. The MAC pass is a single TSC call and isn't interruptible.
+     * Tokens are never cleared by a Core; whoever cancels clears the token before reusing it.
+     */
+    class CancelToken
+     {
+     public:
+      void cancel() { this->flag.store(true, std::memory_order_release); }
+      void clear()  { this->flag.store(false, std::memory_order_release); }
+      bool isCancelled() const { return this->flag.load(std::memory_order_acquire); }
+     private:
+      std::atomic<bool> flag {false};
+     };
+    static constexpr unsigned CANCEL_POLL_MILLISECONDS {10};
+    /* A snapshot of the progress of encrypt() or decrypt(). @bytes_done and @bytes_total count
+     * the bytes of the counter mode and MAC passes over the file together, so that their ratio
+     * tracks the operation as a whole; phases without byte counts (e.g. the KDF) leave them unchanged.
+     * During decrypt() @bytes_total shrinks by the padding size once the padding is known.
+     */
+    struct Progress
+     {
+      Phase    phase       {Phase::COUNT};
+      uint64_t bytes_done  {0};
+      uint64_t bytes_total {0};
+     };
+    /* Publishes Progress snapshots from the thread executing an operation to any number of
+     * polling threads without locks: the writer never waits, and readers retry if they raced a store.
+     */
+    class AtomicProgress
+     {
+     public:
+      Progress load() const;
+      void     store(const Progress& p); // Only one thread may store at a time.
+     private:
+      std::atomic<uint64_t> sequence    {0}; // Odd while a store is in progress.
+      std::atomic<int>      phase       {static_cast<int>(Phase::COUNT)};
+      std::atomic<uint64_t> bytes_done  {0};
+      std::atomic<uint64_t> bytes_total {0};
      };
     using StatusCallback_f  = void(void* data);
   
@@ -150,10 +279,38 @@ namespace fourcrypt
 
     /* Return a raw pointer to a PlainOldData object. */
     PlainOldData*   getPod();
+    /* Return a raw pointer to the KDF progress, which may be polled from other threads. */
+    KdfProgress*    getKdfProgress();
+    /* Return a raw pointer to the operation's progress, which may be polled from other threads. */
+    AtomicProgress* getProgress();
+    /* Return the token that cancels this Core's operations. */
+    CancelToken*    getCancelToken();
+    /* Observe @token instead of the Core's own token; pass nullptr to return to the Core's own. */
+    void            setCancelToken(CancelToken* token);
+    /* Record the duration and byte count of each Phase of subsequent operations into @s.
+     * Pass nullptr to stop recording. */
+    void            setStats(Stats* s);
+    /* Hold @gate while computing the KDF, so that operations sharing @gate compute their KDFs one at a
+     * time and never plan their batch sizes against the same available memory. Waiting for it is
+     * cancellable, and a KDF abandoned on cancellation holds it until the KDF is over, so cancelled
+     * operations never pile up KDFs. Pass nullptr to stop sharing.
+     * @gate must outlive any KDF this Core abandons on cancellation. */
+    void            setKdfGate(std::binary_semaphore* gate);
+    /* Spread the counter mode tiles of subsequent operations across the workers of @ex.
+     * Pass nullptr to use Executor::global(). */
+    void            setExecutor(Executor* ex);
+    /* Reserve the memory of subsequent KDFs from @budget before computing them, waiting for it if
+     * necessary, and never plan a batch larger than the whole of @budget. Pass nullptr to stop.
+     * @budget must outlive any KDF this Core abandons on cancellation. */
+    void            setMemoryBudget(MemoryBudget* budget);
+    /* Wipe everything the previous operation left behind (keys, filenames, password and parameters),
+     * restore the defaults and reseed the CSPRNG from the operating system, so that this Core may
+     * execute another operation. */
+    void            reset();
     /* Initiate counter mode encryption and subsequent MAC authentication.
      * If an error occurs, return the SSC_CodeError_t and specify the
      * ErrType as well as the InOutDir (whether the error occured specifically
-     * with input or output).
+     * with input or output). Both are always set; CORE and NONE unless a file was at fault.
      *
      * When @status_callback is non-nullptr it gets called at several arbitrary intervals to allow
      * external code to roughly track the status of execution.
@@ -162,12 +319,48 @@ namespace fourcrypt
     /* Initiate MAC authentication and subsequent Counter Mode decryption.
      * If an error occurs, return the SSC_CodeError_t and specify the
      * ErrType as well as the InOutDir (whether the error occured specifically
-     * with input or output).
+     * with input or output). Both are always set; CORE and NONE unless a file was at fault.
      *
      * @status_callback gets called at several arbitrary intervals to allow
      * external code to roughly track the status of execution.
      */
     SSC_CodeError_t decrypt(ErrType* err_type, InOutDir* err_dir , StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* Authenticate the input file's MAC as decrypt() does, without deciphering or writing anything.
+     * Return ERROR_MAC_VALIDATION_FAILED if the password is wrong or the file was modified.
+     */
+    SSC_CodeError_t verify(ErrType* err_type, InOutDir* err_dir, StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* Encrypt the bytes of @input into the 4crypt file format at the beginning of @output, without
+     * touching the filesystem. The KDF parameters, padding and password are taken from the
+     * PlainOldData as for encrypt(); the filenames are ignored. Store the size of the encrypted
+     * output at @output_size, also when returning ERROR_BUFFER_TOO_SMALL.
+     * @input and @output must not overlap. See getEncryptedSize(). @status_callback is called as by encrypt().
+     */
+    SSC_CodeError_t encryptBuffer(std::span<uint8_t> output, std::span<const uint8_t> input, uint64_t* output_size,
+                                  StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* As above, but allocate the output. On success store it at @output and its size at @output_size. */
+    SSC_CodeError_t encryptBuffer(std::unique_ptr<uint8_t[]>* output, uint64_t* output_size, std::span<const uint8_t> input);
+    /* Authenticate and decrypt the 4crypt-formatted bytes of @input into the beginning of @output,
+     * without touching the filesystem. Store the size of the plaintext at @output_size once the
+     * padding is known. An @output of getDecryptedSizeBound(@input.size()) bytes is always large enough.
+     * @input and @output must not overlap. @status_callback is called as by decrypt().
+     */
+    SSC_CodeError_t decryptBuffer(std::span<uint8_t> output, std::span<const uint8_t> input, uint64_t* output_size,
+                                  StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* As above, but allocate the output. On success store it at @output and the plaintext size at @output_size. */
+    SSC_CodeError_t decryptBuffer(std::unique_ptr<uint8_t[]>* output, uint64_t* output_size, std::span<const uint8_t> input);
+    /* Return the exact size of the output of encrypting @plaintext_size bytes with the padding
+     * requested by @padding_size and @padding_mode, or 0 if that padding can't be honored.
+     */
+    static uint64_t getEncryptedSize(uint64_t plaintext_size, uint64_t padding_size = 0, PadMode padding_mode = PadMode::ADD);
+    /* Return the size of the plaintext of a @ciphertext_size byte 4crypt file, plus its padding;
+     * i.e. an upper bound on the plaintext size. Return 0 if the size is too small to be a 4crypt file.
+     */
+    static uint64_t getDecryptedSizeBound(uint64_t ciphertext_size);
+    /* Return the largest KDF thread batch size, no greater than @pod's current one, whose concurrently
+     * allocated memory fits within the currently available memory minus a safety margin.
+     * The batch size never affects the derived keys, only how long they take to compute. Never returns 0.
+     */
+    static uint64_t planBatchSize(const PlainOldData& pod);
     /* Describe the metadata of a 4crypt-encrypted file.
      * If an error occurs, return the SSC_CodeError_t and specify the
      * ErrType as well as the InOutDir (whether the error occured specifically
@@ -177,6 +370,12 @@ namespace fourcrypt
      * external code to roughly track the status of execution.
      */
     SSC_CodeError_t describe(ErrType* err_type, InOutDir* err_dir, StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* Return the lowercase name of @phase, e.g. "map_files". */
+    static const char* phaseName(Phase phase);
+    /* Return a std::string representation of the bitshift interpreted as a number of bytes. */
+    static std::string makeMemoryStringBitShift(const uint8_t mem_bitshift);
+    /* Return a std::string representation of the uint64_t interpreted as a number of bytes. */
+    static std::string makeMemoryString(const uint64_t value);
     /* This function returns the size of a 4crypt-encrypted file header. */
     static consteval uint64_t getHeaderSize();
     /* 4crypt metadata consists of the header at the beginning of a file as well as the Message Authentication Code at the end. */
@@ -188,9 +387,23 @@ namespace fourcrypt
     Core();
     ~Core();
    private:
+    friend class Bench; // Times the header and keystream methods in isolation.
   //// Data
 
     PlainOldData*      pod;
+    KdfProgress        kdf_progress;
+    Stats*             stats {nullptr};
+    std::binary_semaphore* kdf_gate {nullptr};
+    Executor*          executor {nullptr};
+    MemoryBudget*      memory_budget {nullptr};
+    CancelToken        own_cancel_token {};
+    CancelToken*       cancel_token {&own_cancel_token};
+    AtomicProgress     progress;
+    Phase              progress_phase {Phase::COUNT};
+    std::array<std::chrono::steady_clock::time_point, static_cast<size_t>(Phase::COUNT)> phase_started {}; // For Metrics.
+    uint64_t           progress_done  {0};
+    uint64_t           progress_total {0};
+    std::vector<uint8_t> small_file_arena {}; // Holds the input and output of small files; wiped after every use.
   //// Static Data
 
     static std::string password_prompt;
@@ -202,18 +415,39 @@ namespace fourcrypt
      * file. Return true when the metadata is valid and false otherwise.
      */
     static bool        verifyBasicMetadata(PlainOldData* extpod, InOutDir dir);
-    /* Return a std::string representation of the bitshift interpreted as a number of bytes. */
-    static std::string makeMemoryStringBitShift(const uint8_t mem_bitshift);
-    /* Return a std::string representation of the uint64_t interpreted as a number of bytes. */
-    static std::string makeMemoryString(const uint64_t value);
-    /* For systems that define SSC_HAS_GETAVAILABLESYSTEMMEMORY...
-     *   Return a left bitwise shift that will not exceed the amount of currently available system memory.
-     * For other systems...
+    /* When the available memory (see Resources) is known...
+     *   Return a left bitwise shift that will not exceed the amount of currently available memory.
+     * Otherwise...
      *   Return a left bitwise shift that will result in a "moderate" amount of memory usage.
      */
     static uint8_t     getDefaultMemoryUsageBitShift(void);
   //// Private methods.
 
+    /* Mark the beginning of @phase. */
+    void            beginPhase(Phase phase);
+    /* Mark the end of @phase, during which @bytes bytes were processed. */
+    void            endPhase(Phase phase, uint64_t bytes = 0);
+    /* Reset the published progress for an operation whose passes will process @bytes_total bytes. */
+    void            startProgress(uint64_t bytes_total);
+    /* Account @bytes more bytes to the published progress of the current phase. */
+    void            advanceProgress(uint64_t bytes);
+    /* Apply @num bytes of the counter mode keystream, starting at the current keystream index, one
+     * CTR_TILE_BYTES tile at a time. If @from is nullptr store the keystream itself at @to,
+     * otherwise store @from XOR the keystream. Return the address just past the last byte stored,
+     * or nullptr if the operation was cancelled first.
+     * When there is more than one tile they are applied in parallel on the executor, each with its
+     * own copy of the cipher, and progress is published after every round of tiles.
+     */
+    uint8_t*        applyKeystream(uint8_t* R_ to, const uint8_t* R_ from, uint64_t num);
+    /* Has the operation been cancelled? */
+    bool            isCancelled() const;
+    /* Stop a cancelled operation: wipe the key material, unmap the files and delete the output file if
+     * it was mapped. Return ERROR_CANCELLED.
+     */
+    SSC_CodeError_t abandon();
+    /* Wipe the derived keys and the cipher state. */
+    void            wipeKeys();
+
     /* Prompt the user for a password to be entered at a command-line terminal. 
      * If @enter_twice is true the user will be prompted a second time to confirm that
      * they entered the password correctly.
@@ -227,6 +461,8 @@ namespace fourcrypt
      * into even blocks of PAD_FACTOR bytes.
      */
     SSC_Error_t     normalizePadding(const uint64_t input_filesize);
+    /* The logic of normalizePadding(), applied to @padding_size and @padding_mode instead of the PlainOldData's. */
+    static SSC_Error_t computePadding(const uint64_t input_size, uint64_t* R_ padding_size, PadMode* R_ padding_mode);
     /* Generate all the pseudorandom data required for the
      * PlainOldData object pointed to inside of Core.
      */
@@ -234,16 +470,39 @@ namespace fourcrypt
     /* Run the key derivation function utilizing as many threads
      * as were specified by the user. This necessitates a lot of dynamic
      * allocation.
+     * Return ERROR_CANCELLED if cancellation was requested before or during the KDF, and
+     * ERROR_KDF_FAILED if the KDF could not be computed.
+     * With USE_AGENT set, a KDF output cached by 4crypt-agent is used instead, and a freshly
+     * computed one is offered to it.
      */
-    SSC_Error_t     runKDF();
+    SSC_CodeError_t runKDF();
+    /* Derive the encryption and authentication keys from the KDF output at @kdf_out, wipe it,
+     * and initialize the counter mode cipher. */
+    void            expandKdfOutput(uint8_t* R_ kdf_out);
     /* Verify that the @size bytes starting at @begin produce the same Message Authentication
      * Code as that stored at @mac.
      */
     SSC_Error_t     verifyMAC(const uint8_t* R_ mac, const uint8_t* R_ begin, const uint64_t size);
+    /* The small-file path of encrypt() and decrypt(), for an input file of @input_size bytes, no more than
+     * @small_file_limit, already open at @fd. Read the input whole into the small file arena, process it
+     * with encryptBuffer() or decryptBuffer(), then store the output with one write() and fdatasync().
+     * Like the mapped paths, encryption creates the output file up front, while decryption creates it only
+     * once the MAC is verified; both call @status_callback at the same points. Avoids memory-mapping
+     * either file, and closes @fd.
+     */
+    SSC_CodeError_t encryptSmallFile(int fd, uint64_t input_size, ErrType* err_type, InOutDir* err_dir,
+                                     StatusCallback_f* status_callback, void* scb_data);
+    SSC_CodeError_t decryptSmallFile(int fd, uint64_t input_size, ErrType* err_type, InOutDir* err_dir,
+                                     StatusCallback_f* status_callback, void* scb_data);
     /* Memory-map the Input and/or Output files.
      * If there's an error return the code and write the direction (input or output) to @map_err_idx.
      */
     SSC_CodeError_t mapFiles(InOutDir* map_err_idx, size_t input_size = 0, size_t output_size = 0, InOutDir only_map = InOutDir::NONE);
+    /* Start reading the first PREFETCH_WINDOW_BYTES of the mapped input so that the reads overlap the KDF.
+     * If @read_once, also hint that the input is walked sequentially just once; on Linux that lets its
+     * pages be reclaimed early, so decrypt(), which reads the input for the MAC and again to decipher
+     * it, doesn't pass it. */
+    void            prefetchInput(bool read_once);
     /* Check the input and output memory maps.
      * For each: if the pointer is valid synchronize the memory map.
      * Fail if either operation fails.
@@ -253,28 +512,27 @@ namespace fourcrypt
      * (if those pointers are non-nullptr).
      */
     void            unmapFiles();
-    /* Write a 4crypt header to the bytes starting at @to.
+    /* Write the header of a @file_size byte 4crypt file to the bytes starting at @to.
      * Return a pointer to the byte immediately following the written header.
      */
-    uint8_t*        writeHeader(uint8_t* to);
-    /* Read the plaintext portion of a 4crypt-encrypted file header's bytes @from, and store any resultant errors
+    uint8_t*        writeHeader(uint8_t* to, const uint64_t file_size);
+    /* Read the plaintext portion of a @file_size byte 4crypt-encrypted file header's bytes @from, and store any resultant errors
      * at @err. On success return a pointer just past the header's plaintext. On failure return an invalid pointer.
      */
-    const uint8_t*  readHeaderPlaintext(const uint8_t* R_ from, SSC_CodeError_t* R_ err);
+    const uint8_t*  readHeaderPlaintext(const uint8_t* R_ from, const uint64_t file_size, SSC_CodeError_t* R_ err);
     /* Read the ciphertext portion of a 4crypt-encrypted file header's bytes @from, and store any resultant errors
      * at @err. On success return a pointer just past the header's ciphertext. On failure return an invalid pointer.
      */
     const uint8_t*  readHeaderCiphertext(const uint8_t* R_ from, SSC_CodeError_t* R_ err);
     /* Encrypt the @num bytes of plaintext at @from and store the
      * ciphertext at @to. Return the address immediately following the last byte
-     * of ciphertext written at @to.
+     * of ciphertext written at @to, or nullptr if cancelled.
      */
     uint8_t*        writeCiphertext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num);
     /* Decrypt the @num bytes of ciphertext at @from and store the
-     * plaintext at @to. Return the address immediately following the last byte
-     * of plaintext written at @to.
+     * plaintext at @to. Return SSC_ERR if cancelled.
      */
-    void            writePlaintext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num);
+    SSC_Error_t     writePlaintext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num);
     /* Calculate the Skein512-MAC of the @num bytes beginning at @from, and store
      * the resulting MAC at @to.
      */
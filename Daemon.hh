@@ -0,0 +1,87 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_DAEMON_HH
+#define FOURCRYPT_DAEMON_HH
+
+// Local
+#include "Session.hh"
+// C++ STL
+#include <string>
+
+namespace fourcrypt
+ {
+  /* The protocol between 4cryptd and its clients, over a per-user Unix domain socket.
+   *
+   * A client connects, sends one Request followed by its input path, output path and password, and
+   * then receives Events until the DONE event, after which the daemon closes the connection. Paths
+   * must be absolute, since the daemon doesn't share the client's working directory. Closing the
+   * connection early cancels the job. Both ends run on the same host, so fields are in host order.
+   */
+  class Daemon
+   {
+   public:
+    static constexpr uint8_t  PROTOCOL_VERSION {1};
+    static constexpr unsigned TIMEOUT_MILLISECONDS {1000};
+    static constexpr unsigned PROGRESS_MILLISECONDS {100};
+    static constexpr size_t   MAX_PATH_BYTES {4096};
+    struct Request
+     {
+      uint8_t  version;
+      uint8_t  mode;         // Core::ExeMode: ENCRYPT, DECRYPT or VERIFY.
+      uint8_t  preset;       // Session::Preset
+      uint8_t  flags;
+      uint8_t  memory_low;
+      uint8_t  memory_high;
+      uint8_t  iterations;
+      uint8_t  padding_mode; // Core::PadMode
+      uint64_t thread_count;
+      uint64_t thread_batch_size;
+      uint64_t padding_size;
+      uint16_t input_size;
+      uint16_t output_size;  // 0 to derive the output path from the input path.
+      uint16_t password_size;
+      uint16_t reserved;
+     };
+    enum class EventKind : uint8_t
+     {
+      QUEUED   = 1, // Accepted and waiting for a free slot.
+      RUNNING  = 2, // Started; its KDF may still wait for memory.
+      PROGRESS = 3,
+      DONE     = 4  // Finished with @code, @error_type and @error_dir as returned by Session::run().
+     };
+    struct Event
+     {
+      EventKind kind;
+      uint8_t   phase;      // Core::Phase
+      uint8_t   error_type; // Core::ErrType
+      uint8_t   error_dir;  // Core::InOutDir
+      int32_t   code;
+      uint64_t  job_id;
+      uint64_t  bytes_done;
+      uint64_t  bytes_total;
+     };
+
+    /* Return the path of the daemon's socket: $FOURCRYPT_DAEMON_SOCK if set, otherwise
+     * local_socket_path("daemon"). */
+    static std::string socketPath(void);
+    /* Send @job with its @password_size byte @password over @fd. */
+    static bool sendJob(int fd, const Session::Job& job, const uint8_t* password, size_t password_size);
+    /* Receive a job sent by sendJob() from @fd into @job. Return false if it is malformed. */
+    static bool recvJob(int fd, Session::Job* job);
+   };
+ } // ! namespace fourcrypt
+#endif
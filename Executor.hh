@@ -0,0 +1,86 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_EXECUTOR_HH
+#define FOURCRYPT_EXECUTOR_HH
+
+// C++ STL
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+// C++ C Lib
+#include <cstdint>
+
+namespace fourcrypt
+ {
+  /* A fixed set of worker threads executing posted tasks in FIFO order. Tasks posted while every worker
+   * is busy wait in the queue instead of occupying a thread each. The destructor finishes every task
+   * posted before it began, then joins the workers.
+   *
+   * One process-wide instance, global(), is shared by the counter mode tiles of every Core, so that neither
+   * thread creation nor oversubscription scale with the number of jobs. Whole jobs, which block their
+   * worker for the length of a KDF, run on a second one, jobs(), so they never hold up those tiles.
+   */
+  class Executor
+   {
+   public:
+    using Task_t = std::function<void()>;
+    using Body_f = std::function<void(uint64_t)>;
+
+    /* How the workers are pinned to the processors this process may run on.
+     * COMPACT fills the hardware threads of one core, then one socket, before moving on;
+     * SCATTER spreads consecutive workers across sockets, then cores, using SMT siblings last. */
+    enum class Affinity
+     {
+      NONE, COMPACT, SCATTER
+     };
+
+    /* Start @threads workers; 0 for one per usable processor. */
+    explicit Executor(unsigned threads = 0, Affinity affinity = Affinity::NONE);
+    ~Executor();
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /* Queue @task to execute on a worker thread. */
+    void     post(Task_t task);
+    /* Call @body with every index in [0, @count), spread across the workers and the calling thread,
+     * and return once every call has returned. The caller claims indices alongside the workers, so
+     * this never deadlocks, even when called from a worker of a fully occupied executor.
+     * @body must not throw. */
+    void     parallelFor(uint64_t count, const Body_f& body);
+    unsigned threadCount(void) const;
+    /* Choose the size and affinity of the process-wide executor. Takes effect only before the first
+     * call to global(); return false if it was already started. */
+    static bool      configureGlobal(unsigned threads, Affinity affinity);
+    /* Return the process-wide executor, started on first use. */
+    static Executor& global(void);
+    /* Return the process-wide executor for tasks that block for a whole job, such as the GUI's
+     * operations and AsyncOperation's, started on first use with one worker per usable processor. */
+    static Executor& jobs(void);
+   private:
+    std::mutex               mtx     {};
+    std::condition_variable  cv      {};
+    std::deque<Task_t>       tasks   {};
+    std::vector<std::thread> workers {};
+    bool                     stopping {false};
+
+    void work(unsigned cpu);
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -19,6 +19,7 @@
 
 // Local
 #include "Core.hh"
+#include "Session.hh"
 // GTK4
 #include <gtk/gtk.h>
 // C++ STL
@@ -52,14 +53,14 @@ void make_os_path(std::string& str);
 class Gui
  {
  public:
- // Public Types //
-  using Pod_t = Core::PlainOldData;
  // Public Constants //
   enum class Mode
    {
     NONE, ENCRYPT, DECRYPT
    };
-  static constexpr double PROGRESS_PULSE_STEP {0.14285714285714285}; //FIXME: Fraction of total number of steps.
+  static constexpr double PROGRESS_PULSE_STEP {0.1}; // Pulse the progress bar by this much while the KDF runs.
+  static constexpr guint  PROGRESS_POLL_MILLISECONDS {100};
+  static constexpr guint  STATUS_BLINK_MILLISECONDS  {750};
   static constexpr int    TEXT_HEIGHT {20};
  // Public Static Procedures //
   #ifdef FOURCRYPT_IS_PORTABLE
@@ -108,6 +109,9 @@ class Gui
 
   GtkWidget*      mProgressBox {};     // Contain the progress bar.
   GtkWidget*      mProgressBar {};     // I track the progress of encryption/decryption.
+  GtkWidget*      mCancelButton {};    // Click me to abandon the ongoing encryption/decryption.
+  guint           mProgressSource {};  // Periodically refresh the progress bar while an operation is ongoing.
+  guint           mStatusBlinkSource {}; // Periodically blink the status while it awaits dismissal.
 
   GtkWidget*      mInputBox    {};       // Contain the Label, Text, & Button for input.
   GtkWidget*      mInputLabel  {};
@@ -148,8 +152,9 @@ class Gui
   GtkWidget*      mStatusBox   {};
   GtkWidget*      mStatusLabel {};
 
-  Core*           mCore {};                // Access the primary 4crypt methods through me.
-  Pod_t*          mPod  {};                // Access the primary 4crypt data through me.
+  Core*           mCore {};                // Jobs execute on me, so that the progress bar can poll my progress.
+  Session         mSession {};             // Execute jobs through me.
+  Session::Job    mJob  {};                // Describe the next (or ongoing) job to me.
   Mode            mMode {Mode::NONE};      // Encrypt mode? Decrypt mode?
   int             mArgc {};                // "argc" passed in from main(int argc, char* argv[])
   char**          mArgv {};                // "argv" passed in from main(int argc, char* argv[])
@@ -180,19 +185,20 @@ class Gui
   bool getPassword(void);
   void clearPasswordEntries(void);
   void setStatusLabelSuccess(bool);
+  void refreshProgressBar(void);
+  void startProgressPolling(void);
 
-  // Update progress bar percentage until it's full.
+  // Refresh the progress bar from the Core's published progress at the next opportunity.
   static void updateProgressCallback(void* cb_data);
-  // Encryption happens in a separate thread, and we pass in a progress bar update function and a Gui* as its callback data.
+  // Encryption happens on the process-wide Executor, and we pass in a progress bar update function and a Gui* as its callback data.
   static void encryptThread(Core::StatusCallback_f* status_callback, void* status_callback_data);
-  // Decryption happens in a separate thread, and we pass in a progress bar update function and a Gui* as its callback data.
+  // Decryption happens on the process-wide Executor, and we pass in a progress bar update function and a Gui* as its callback data.
   static void decryptThread(Core::StatusCallback_f* status_callback, void* status_callback_data);
-  // Update the status text and blink it on-screen until dismissed by falsifying @mStatusIsBlinking.
-  static void statusThread(void* vgui);
+  // Blink the status on-screen from the main loop until dismissed by falsifying @mStatusIsBlinking.
+  static gboolean startStatusBlinking(void* vgui);
+  static gboolean blinkStatus(void* vgui);
 
   static gboolean endOperation(void* vgui);
-  static gboolean makeStatusVisible(void* vgui);
-  static gboolean makeStatusInvisible(void* vgui);
  //// Private Static Pseudo-Methods.
   static void onApplicationActivate(GtkApplication*,        void*);
   static void onEncryptButtonClicked(GtkWidget*,           void*);
@@ -202,6 +208,7 @@ class Gui
   static void onOutputButtonClicked(GtkWidget*,            void*);
   static void onOutputTextActivate(GtkWidget*,             void*);
   static void onStartButtonClicked(GtkWidget*,             void*);
+  static void onCancelButtonClicked(GtkWidget*,            void*);
   static void onPasswordEntryActivate(GtkWidget*,          void*);
   static void onReentryEntryActivate(GtkWidget*,           void*);
   static void onExpertModeCheckbuttonToggled(GtkWidget*,  void*);
@@ -0,0 +1,110 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Agent.hh"
+#include "LocalSocket.hh"
+// SSC
+#include <SSC/Memory.h>
+// TSC
+#include <TSC/Kdf.h>
+#include <TSC/Skein512.h>
+// C++ C Lib
+#include <cstdlib>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <unistd.h>
+#endif
+using namespace fourcrypt;
+
+static_assert(Agent::VALUE_BYTES == TSC_KDF_OUTPUT_BYTES);
+static_assert(sizeof(Agent::Request) == 2 + Agent::DIGEST_BYTES + Agent::VALUE_BYTES);
+static_assert(sizeof(Agent::Reply)   == 1 + Agent::VALUE_BYTES);
+
+std::string
+Agent::socketPath(void)
+{
+  if (const char* sock {std::getenv("FOURCRYPT_AGENT_SOCK")}; sock != nullptr and sock[0] != '\0')
+    return sock;
+  return local_socket_path("agent");
+}
+void
+Agent::digest(const Core::PlainOldData& pod, uint8_t* out)
+{
+  // salt || thread_count (little endian) || memory_low || memory_high || iterations || phi || password
+  uint8_t  buffer [TSC_CATENA512_SALT_BYTES + 12 + Core::PW_BUFFER_BYTES];
+  uint8_t* p {buffer};
+  memcpy(p, pod.catena_salt, sizeof(pod.catena_salt));
+  p += sizeof(pod.catena_salt);
+  for (int i {0}; i < 8; ++i)
+    *p++ = static_cast<uint8_t>(pod.thread_count >> (8 * i));
+  *p++ = pod.memory_low;
+  *p++ = pod.memory_high;
+  *p++ = pod.iterations;
+  *p++ = (pod.flags & Core::ENABLE_PHI) ? 1 : 0;
+  memcpy(p, pod.password_buffer, pod.password_size);
+  p += pod.password_size;
+  TSC_Skein512 skein;
+  TSC_Skein512_hash(&skein, out, DIGEST_BYTES, buffer, static_cast<uint64_t>(p - buffer));
+  SSC_secureZero(&skein, sizeof(skein));
+  SSC_secureZero(buffer, sizeof(buffer));
+}
+
+bool
+Agent::lookup(const Core::PlainOldData& pod, uint8_t* out)
+{
+  Request req {PROTOCOL_VERSION, Op::LOOKUP, {}, {}};
+  Reply   reply {};
+  Agent::digest(pod, req.digest);
+  const bool found {Agent::transact(req, &reply) and reply.found == 1};
+  if (found)
+    memcpy(out, reply.value, sizeof(reply.value));
+  SSC_secureZero(&req, sizeof(req));
+  SSC_secureZero(&reply, sizeof(reply));
+  return found;
+}
+
+void
+Agent::store(const Core::PlainOldData& pod, const uint8_t* value)
+{
+  Request req {PROTOCOL_VERSION, Op::STORE, {}, {}};
+  Reply   reply {};
+  Agent::digest(pod, req.digest);
+  memcpy(req.value, value, sizeof(req.value));
+  Agent::transact(req, &reply);
+  SSC_secureZero(&req, sizeof(req));
+}
+
+bool
+Agent::clear(void)
+{
+  Request req {PROTOCOL_VERSION, Op::CLEAR, {}, {}};
+  Reply   reply {};
+  return Agent::transact(req, &reply);
+}
+
+bool
+Agent::transact(const Request& req, Reply* reply)
+{
+  // Keys are only ever sent to, or accepted from, an agent running as ourselves.
+  const int fd {local_connect(Agent::socketPath(), TIMEOUT_MILLISECONDS)};
+  if (fd == -1)
+    return false;
+  const bool ok {local_send_all(fd, &req, sizeof(req)) and local_recv_all(fd, reply, sizeof(*reply))};
+#if defined(SSC_OS_UNIXLIKE)
+  close(fd);
+#endif
+  return ok;
+}
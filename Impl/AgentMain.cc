@@ -0,0 +1,318 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Local
+#include "Agent.hh"
+#include "LocalSocket.hh"
+#include "Util.hh"
+// SSC
+#include <SSC/CommandLineArg.h>
+#include <SSC/Error.h>
+#include <SSC/Memory.h>
+// C++ STL
+#include <array>
+#include <chrono>
+#include <string>
+// C++ C Lib
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <poll.h>
+ #include <sys/mman.h>
+ #include <sys/socket.h>
+ #include <unistd.h>
+#endif
+#if defined(__linux__)
+ #include <sys/prctl.h>
+#endif
+#define R_ SSC_RESTRICT
+using namespace fourcrypt;
+using Clock_t = std::chrono::steady_clock;
+
+#if !defined(SSC_OS_UNIXLIKE)
+int main(void)
+{
+  std::fputs("4crypt-agent requires Unix domain sockets.\n", stderr);
+  return EXIT_FAILURE;
+}
+#else
+
+// Enough for every file an analyst keeps open in a day; the table is locked into memory as a whole.
+constexpr size_t MAX_ENTRIES {256};
+// Wake up at least this often to wipe expired entries.
+constexpr int    SWEEP_MILLISECONDS {1000};
+
+struct Options
+ {
+  std::string socket_path {};
+  uint64_t    ttl_seconds {Agent::DEFAULT_TTL_SECONDS};
+  bool        clear       {false};
+ };
+
+struct Entry
+ {
+  uint8_t             digest [Agent::DIGEST_BYTES];
+  uint8_t             value  [Agent::VALUE_BYTES];
+  Clock_t::time_point expires;
+  bool                used;
+ };
+
+static volatile std::sig_atomic_t stopping {0};
+
+static void
+on_stop_signal(int)
+{
+  stopping = 1;
+}
+
+static void
+wipe_entry(Entry& e)
+{
+  SSC_secureZero(&e, sizeof(e));
+}
+
+/* Wipe every entry that has outlived the TTL. */
+static void
+sweep(Entry* entries, Clock_t::time_point now)
+{
+  for (size_t i {0}; i < MAX_ENTRIES; ++i) {
+    if (entries[i].used and entries[i].expires <= now)
+      wipe_entry(entries[i]);
+  }
+}
+
+/* Return the entry whose digest is @digest, or nullptr. Every entry is compared in constant time. */
+static Entry*
+find(Entry* entries, const uint8_t* R_ digest)
+{
+  Entry* found {nullptr};
+  for (size_t i {0}; i < MAX_ENTRIES; ++i) {
+    if (entries[i].used and SSC_constTimeMemDiff(entries[i].digest, digest, Agent::DIGEST_BYTES) == 0)
+      found = &entries[i];
+  }
+  return found;
+}
+
+/* Return the entry to store @digest in: its own, a free one, or the one closest to expiring. */
+static Entry*
+slot_for(Entry* entries, const uint8_t* R_ digest)
+{
+  if (Entry* e {find(entries, digest)}; e != nullptr)
+    return e;
+  Entry* victim {&entries[0]};
+  for (size_t i {0}; i < MAX_ENTRIES; ++i) {
+    if (not entries[i].used)
+      return &entries[i];
+    if (entries[i].expires < victim->expires)
+      victim = &entries[i];
+  }
+  wipe_entry(*victim);
+  return victim;
+}
+
+static void
+serve(int client, Entry* entries, const Options& opt)
+{
+  Agent::Request req   {};
+  Agent::Reply   reply {};
+  local_set_timeouts(client, Agent::TIMEOUT_MILLISECONDS);
+  if (not local_peer_is_self(client) or not local_recv_all(client, &req, sizeof(req)) or req.version != Agent::PROTOCOL_VERSION) {
+    SSC_secureZero(&req, sizeof(req));
+    return;
+  }
+  const Clock_t::time_point now {Clock_t::now()};
+  sweep(entries, now);
+  switch (req.op) {
+    case Agent::Op::LOOKUP:
+      if (Entry* e {find(entries, req.digest)}; e != nullptr) {
+        reply.found = 1;
+        memcpy(reply.value, e->value, sizeof(reply.value));
+      }
+      break;
+    case Agent::Op::STORE: {
+      Entry* e {slot_for(entries, req.digest)};
+      memcpy(e->digest, req.digest, sizeof(e->digest));
+      memcpy(e->value , req.value , sizeof(e->value));
+      e->expires = now + std::chrono::seconds(opt.ttl_seconds);
+      e->used    = true;
+      reply.found = 1;
+    } break;
+    case Agent::Op::CLEAR:
+      for (size_t i {0}; i < MAX_ENTRIES; ++i)
+        wipe_entry(entries[i]);
+      reply.found = 1;
+      break;
+  }
+  local_send_all(client, &reply, sizeof(reply));
+  SSC_secureZero(&req, sizeof(req));
+  SSC_secureZero(&reply, sizeof(reply));
+}
+
+/* Allocate the cache where it can't be swapped out or written into a core dump. */
+static Entry*
+lock_entries(void)
+{
+  const size_t size {MAX_ENTRIES * sizeof(Entry)};
+  void* p {mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  SSC_assertMsg(p != MAP_FAILED, "Error: Failed to allocate the cache!\n");
+  SSC_assertMsg(
+   mlock(p, size) == 0,
+   "Error: Failed to lock %zu bytes of memory (%s). Raise RLIMIT_MEMLOCK (ulimit -l).\n", size, std::strerror(errno));
+ #if defined(MADV_DONTDUMP)
+  madvise(p, size, MADV_DONTDUMP);
+ #endif
+  return static_cast<Entry*>(p);
+}
+
+static void
+print_help(void)
+{
+  std::puts(
+   "Usage: 4crypt-agent [options]\n"
+   "Keep the KDF outputs of recently opened files in locked memory, for 4crypt --agent.\n"
+   "-h, --help                  Print help output.\n"
+   "--socket=<filepath>         Listen here instead of $FOURCRYPT_AGENT_SOCK, $XDG_RUNTIME_DIR/4crypt-agent.sock\n"
+   "                              or /tmp/4crypt-<uid>/agent.sock.\n"
+   "--ttl=<seconds>             Forget each KDF output this long after it was stored (default 600).\n"
+   "--clear                     Make the running agent forget every KDF output, then exit.\n"
+   "The agent runs in the foreground until SIGINT or SIGTERM, and wipes its cache on exit.");
+}
+
+#define ARGS_ const int argc, char** R_ argv, const int offset, void* R_ data
+
+static int
+agent_clear(const int, char** R_ argv, const int offset, void* R_ data)
+{
+  static_cast<Options*>(data)->clear = true;
+  return SSC_1opt(argv[0][offset]);
+}
+
+static int
+agent_help(ARGS_)
+{
+  print_help();
+  std::exit(EXIT_SUCCESS);
+  return 0;
+}
+
+static int
+agent_socket(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Options*>(dt)->socket_path.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+agent_ttl(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t ttl {parse_integer(ap->to_read, ap->size)};
+     SSC_assertMsg(ttl > 0 and ttl <= UINT64_C(86400), "Error: Invalid TTL '%s'! Expected 1 to 86400 seconds.\n", ap->to_read);
+     static_cast<Options*>(dt)->ttl_seconds = ttl;
+     return SSC_OK;
+   });
+}
+#undef ARGS_
+
+const std::array<SSC_ArgShort, 1> shorts = {{
+  SSC_ARGSHORT_LITERAL(agent_help, 'h'),
+}};
+
+const std::array<SSC_ArgLong, 4> longs = {{
+  SSC_ARGLONG_LITERAL(agent_clear,  "clear"),
+  SSC_ARGLONG_LITERAL(agent_help,   "help"),
+  SSC_ARGLONG_LITERAL(agent_socket, "socket"),
+  SSC_ARGLONG_LITERAL(agent_ttl,    "ttl"),
+}};
+
+int main(int argc, char* argv[])
+{
+  Options opt {};
+  if (argc > 1) {
+    SSC_processCommandLineArgs(
+     argc - 1,
+     argv + 1,
+     shorts.size(),
+     shorts.data(),
+     longs.size(),
+     longs.data(),
+     &opt,
+     nullptr);
+  }
+  if (opt.socket_path.empty())
+    opt.socket_path = Agent::socketPath();
+  else
+    setenv("FOURCRYPT_AGENT_SOCK", opt.socket_path.c_str(), 1);
+  if (opt.clear) {
+    if (not Agent::clear()) {
+      std::fprintf(stderr, "No agent answered on %s.\n", opt.socket_path.c_str());
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+ #if defined(__linux__)
+  // Keep other processes of the same user from reading the cache through ptrace or /proc/pid/mem.
+  prctl(PR_SET_DUMPABLE, 0);
+ #endif
+  Entry*    entries {lock_entries()};
+  const int server  {local_listen(opt.socket_path)};
+  struct sigaction sa {};
+  sa.sa_handler = &on_stop_signal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT , &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::fprintf(stderr, "4crypt-agent listening on %s\n", opt.socket_path.c_str());
+  while (not stopping) {
+    pollfd pfd {server, POLLIN, 0};
+    const int ready {poll(&pfd, 1, SWEEP_MILLISECONDS)};
+    sweep(entries, Clock_t::now());
+    if (ready <= 0)
+      continue;
+    if (const int client {accept(server, nullptr, nullptr)}; client != -1) {
+      serve(client, entries, opt);
+      close(client);
+    }
+  }
+  close(server);
+  unlink(opt.socket_path.c_str());
+  SSC_secureZero(entries, MAX_ENTRIES * sizeof(Entry));
+  munlock(entries, MAX_ENTRIES * sizeof(Entry));
+  munmap(entries, MAX_ENTRIES * sizeof(Entry));
+  return EXIT_SUCCESS;
+}
+#endif // SSC_OS_UNIXLIKE
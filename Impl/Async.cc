@@ -0,0 +1,76 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Async.hh"
+using namespace fourcrypt;
+
+AsyncOperation::AsyncOperation(
+ Session&            param_session,
+ const Session::Job& param_job,
+ Executor&           param_executor,
+ Resume_f*           param_resume,
+ void*               param_resume_data)
+: session{&param_session}, job{param_job}, executor{&param_executor}, resume{param_resume}, resume_data{param_resume_data}
+{
+  this->core.setCancelToken(&this->cancel_token);
+}
+
+AsyncOperation::AsyncOperation(
+ Session&                 param_session,
+ const Session::Job&      param_job,
+ std::span<uint8_t>       param_output,
+ std::span<const uint8_t> param_input,
+ Executor&                param_executor,
+ Resume_f*                param_resume,
+ void*                    param_resume_data)
+: session{&param_session}, job{param_job}, executor{&param_executor}, resume{param_resume}, resume_data{param_resume_data},
+  output{param_output}, input{param_input}, is_buffer{true}
+{
+  this->core.setCancelToken(&this->cancel_token);
+}
+
+void
+AsyncOperation::await_suspend(std::coroutine_handle<> handle)
+{
+  this->executor->post([this, handle]() { this->execute(handle); });
+}
+
+void
+AsyncOperation::cancel(void)
+{
+  this->cancel_token.cancel();
+}
+
+Core::Progress
+AsyncOperation::progress(void)
+{
+  return this->core.getProgress()->load();
+}
+
+void
+AsyncOperation::execute(std::coroutine_handle<> handle)
+{
+  if (this->cancel_token.isCancelled())
+    this->result.code = Core::ERROR_CANCELLED;
+  else if (this->is_buffer)
+    this->result = this->session->runBuffer(this->job, this->core, this->output, this->input, &this->output_size);
+  else
+    this->result = this->session->run(this->job, this->core);
+  if (this->resume != nullptr)
+    this->resume(handle, this->resume_data);
+  else
+    handle.resume();
+}
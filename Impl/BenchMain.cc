@@ -0,0 +1,738 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Local
+#include "Bench.hh"
+#include "Resources.hh"
+#include "Util.hh"
+// SSC
+#include <SSC/CommandLineArg.h>
+#include <SSC/Error.h>
+// TSC
+#include <TSC/CSPRNG.h>
+#include <TSC/Kdf.h>
+#include <TSC/Skein512.h>
+#include <TSC/Threefish512.h>
+// C++ STL
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+// C++ C Lib
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <unistd.h>
+#endif
+#define R_ SSC_RESTRICT
+using namespace fourcrypt;
+using PlainOldData = Core::PlainOldData;
+using Clock_t      = std::chrono::steady_clock;
+
+constexpr double   MEBIBYTE {1024.0 * 1024.0};
+constexpr double   GIBIBYTE {MEBIBYTE * 1024.0};
+// End-to-end runs use a 4 Mebibyte KDF, so that they measure the data path rather than the KDF.
+constexpr uint8_t  E2E_KDF_MEM {16};
+constexpr uint64_t MAX_BATCH   {UINT64_C(1) << 20};
+
+/* Fill @size bytes at @dest with pseudorandom bytes. */
+static void
+fill_random(void* dest, uint64_t size)
+{
+  static TSC_CSPRNG rng {[]() { TSC_CSPRNG r; TSC_CSPRNG_init(&r); return r; }()};
+  TSC_CSPRNG_getBytes(&rng, dest, size);
+}
+
+/* Give @core's Threefish512-CTR and MAC random keys, tweak and IV. */
+static void
+init_random_keys(Core& core)
+{
+  PlainOldData* pod {core.getPod()};
+  fill_random(pod->tf_sec_key, TSC_THREEFISH512_BLOCK_BYTES);
+  fill_random(pod->tf_tweak  , TSC_THREEFISH512_TWEAK_BYTES);
+  fill_random(pod->tf_ctr_iv , sizeof(pod->tf_ctr_iv));
+  fill_random(pod->mac_key   , sizeof(pod->mac_key));
+  TSC_Threefish512Ctr_init(&pod->tf_ctr, pod->tf_sec_key, pod->tf_tweak, pod->tf_ctr_iv);
+}
+
+static char*
+copy_cstr(const std::string& str, uint64_t* size)
+{
+  char* c {new char[str.size() + 1]};
+  std::memcpy(c, str.c_str(), str.size() + 1);
+  *size = str.size();
+  return c;
+}
+
+static Bench::Summary
+summarize(std::vector<double>& samples)
+{
+  Bench::Summary s {};
+  if (samples.empty())
+    return s;
+  std::sort(samples.begin(), samples.end());
+  // Nearest-rank percentiles.
+  auto percentile = [&samples](double p) -> double {
+    const size_t rank {static_cast<size_t>(std::ceil(p * static_cast<double>(samples.size())))};
+    return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+  };
+  s.min    = samples.front();
+  s.median = percentile(0.50);
+  s.p90    = percentile(0.90);
+  s.p99    = percentile(0.99);
+  for (double d : samples)
+    s.mean += d;
+  s.mean /= static_cast<double>(samples.size());
+  return s;
+}
+
+/* Run @op @warmup times and discard the timings, then time it @repeats times. Operations shorter than
+ * Bench::MIN_SAMPLE_SECONDS are run in batches, each sample being the mean over its batch.
+ */
+template <typename Op_t>
+static Bench::Summary
+measure(Op_t&& op, int warmup, int repeats)
+{
+  for (int i {0}; i < warmup; ++i)
+    op();
+  uint64_t batch {1};
+  {
+    const auto start {Clock_t::now()};
+    op();
+    const double seconds {std::chrono::duration<double>(Clock_t::now() - start).count()};
+    if (seconds < Bench::MIN_SAMPLE_SECONDS)
+      batch = std::min(MAX_BATCH, static_cast<uint64_t>(std::ceil(Bench::MIN_SAMPLE_SECONDS / std::max(seconds, 1e-9))));
+  }
+  std::vector<double> samples;
+  samples.reserve(static_cast<size_t>(repeats));
+  for (int r {0}; r < repeats; ++r) {
+    const auto start {Clock_t::now()};
+    for (uint64_t b {0}; b < batch; ++b)
+      op();
+    samples.push_back(std::chrono::duration<double>(Clock_t::now() - start).count() / static_cast<double>(batch));
+  }
+  return summarize(samples);
+}
+
+static Bench::Result
+throughput_result(std::string name, const char* group, uint64_t bytes, int samples, const Bench::Summary& s)
+{
+  Bench::Result r {};
+  r.name    = std::move(name);
+  r.group   = group;
+  r.bytes   = bytes;
+  r.samples = samples;
+  r.seconds = s;
+  r.metric  = "mib_per_s";
+  r.value   = (static_cast<double>(bytes) / MEBIBYTE) / s.median;
+  r.higher_is_better = true;
+  return r;
+}
+
+Bench::Bench(const Options& opt)
+ : options{opt}
+{
+  if (this->options.quick) {
+    this->options.warmup    = std::min(this->options.warmup, 1);
+    this->options.repeats   = std::min(this->options.repeats, 5);
+    this->options.file_size = std::min(this->options.file_size, UINT64_C(16) << 20);
+  }
+  if (this->options.dirs.empty()) {
+    std::error_code ec;
+    if (std::filesystem::is_directory("/dev/shm", ec))
+      this->options.dirs.emplace_back("/dev/shm"); // tmpfs.
+    this->options.dirs.emplace_back(".");
+  }
+}
+
+bool Bench::selected(const std::string& name) const
+{
+  return this->options.filter.empty() or name.find(this->options.filter) != std::string::npos;
+}
+
+void Bench::record(Result&& r)
+{
+  std::fprintf(stderr, "%-32s %14.3f %s\n", r.name.c_str(), r.value, r.metric);
+  this->results.push_back(std::move(r));
+}
+
+const std::vector<Bench::Result>& Bench::getResults(void) const
+{
+  return this->results;
+}
+
+void Bench::run(void)
+{
+  this->benchCtr();
+  this->benchMac();
+  this->benchHeader();
+  this->benchKdf();
+  this->benchEndToEnd();
+}
+
+void Bench::benchCtr(void)
+{
+  std::vector<uint64_t> sizes {64, 4096, 65536, UINT64_C(1) << 20};
+  if (not this->options.quick)
+    sizes.push_back(UINT64_C(16) << 20);
+  Core core {};
+  PlainOldData* pod {core.getPod()};
+  init_random_keys(core);
+  std::vector<uint8_t> in  (sizes.back());
+  std::vector<uint8_t> out (sizes.back());
+  fill_random(in.data(), in.size());
+  for (const uint64_t size : sizes) {
+    // The raw TSC primitive.
+    std::string name {"ctr/xor/" + std::to_string(size)};
+    if (this->selected(name)) {
+      const Summary s {measure(
+       [&]() { TSC_Threefish512Ctr_xor_2(&pod->tf_ctr, out.data(), in.data(), size, 0); },
+       this->options.warmup,
+       this->options.repeats)};
+      this->record(throughput_result(std::move(name), "ctr", size, this->options.repeats, s));
+    }
+    // Core's tiled pass, as used by encrypt() and decrypt().
+    name = "ctr/tiled/" + std::to_string(size);
+    if (this->selected(name)) {
+      const Summary s {measure(
+       [&]() { pod->tf_ctr_idx = 0; core.applyKeystream(out.data(), in.data(), size); },
+       this->options.warmup,
+       this->options.repeats)};
+      this->record(throughput_result(std::move(name), "ctr", size, this->options.repeats, s));
+    }
+  }
+}
+
+void Bench::benchMac(void)
+{
+  std::vector<uint64_t> sizes {64, 4096, 65536, UINT64_C(1) << 20};
+  if (not this->options.quick)
+    sizes.push_back(UINT64_C(16) << 20);
+  Core core {};
+  PlainOldData* pod {core.getPod()};
+  init_random_keys(core);
+  std::vector<uint8_t> in (sizes.back());
+  uint8_t mac [TSC_THREEFISH512_BLOCK_BYTES];
+  fill_random(in.data(), in.size());
+  for (const uint64_t size : sizes) {
+    std::string name {"mac/" + std::to_string(size)};
+    if (not this->selected(name))
+      continue;
+    const Summary s {measure(
+     [&]() { TSC_Skein512_mac(pod->skein512, mac, sizeof(mac), in.data(), size, pod->mac_key); },
+     this->options.warmup,
+     this->options.repeats)};
+    this->record(throughput_result(std::move(name), "mac", size, this->options.repeats, s));
+  }
+}
+
+void Bench::benchHeader(void)
+{
+  Core core {};
+  PlainOldData* pod {core.getPod()};
+  core.genRandomElements();
+  init_random_keys(core);
+  // The header records the file size; parsing checks it against the size it's given.
+  constexpr uint64_t file_size {UINT64_C(1) << 20};
+  alignas(uint64_t) uint8_t header [512];
+  const uint64_t header_size {static_cast<uint64_t>(core.writeHeader(header, file_size) - header)};
+  auto latency_result = [this, header_size](std::string name, const Summary& s) -> Result {
+    Result r {};
+    r.name    = std::move(name);
+    r.group   = "header";
+    r.bytes   = header_size;
+    r.samples = this->options.repeats;
+    r.seconds = s;
+    r.metric  = "ns";
+    r.value   = s.median * 1e9;
+    r.higher_is_better = false;
+    return r;
+  };
+  if (this->selected("header/write")) {
+    const Summary s {measure(
+     [&]() { pod->tf_ctr_idx = 0; core.writeHeader(header, file_size); },
+     this->options.warmup,
+     this->options.repeats)};
+    this->record(latency_result("header/write", s));
+  }
+  if (this->selected("header/parse")) {
+    const Summary s {measure(
+     [&]() {
+       SSC_CodeError_t err {0};
+       pod->tf_ctr_idx = 0;
+       const uint8_t* p {core.readHeaderPlaintext(header, file_size, &err)};
+       core.readHeaderCiphertext(p, &err);
+       SSC_assertMsg(err == 0, "Error: Failed to parse a freshly written header!\n");
+     },
+     this->options.warmup,
+     this->options.repeats)};
+    this->record(latency_result("header/parse", s));
+  }
+}
+
+void Bench::benchKdf(void)
+{
+  std::vector<uint8_t>  mems    {Core::MEM_FAST};
+  std::vector<uint64_t> threads {1, 2};
+  if (not this->options.quick) {
+    mems.push_back(Core::MEM_NORMAL);
+    mems.push_back(Core::MEM_STRONG);
+    threads.push_back(4);
+  }
+  const uint64_t processors {Resources::detect().usableProcessors()};
+  const int      warmup     {this->options.quick ? 0 : 1};
+  const int      repeats    {std::min(this->options.repeats, this->options.quick ? 3 : 5)};
+  alignas(uint64_t) uint8_t salt [TSC_CATENA512_SALT_BYTES];
+  uint8_t password [] {'4', 'c', 'r', 'y', 'p', 't'};
+  uint8_t output   [TSC_KDF_OUTPUT_BYTES];
+  fill_random(salt, sizeof(salt));
+  for (const uint8_t mem : mems) {
+    for (const uint64_t thread_count : threads) {
+      if (thread_count > 1 and thread_count > processors)
+        continue;
+      std::vector<uint64_t> batch_sizes {1};
+      if (thread_count > 1)
+        batch_sizes.push_back(thread_count);
+      for (const uint64_t batch_size : batch_sizes) {
+        std::string name {
+         "kdf/m" + std::to_string(mem) + "/t" + std::to_string(thread_count) + "/b" + std::to_string(batch_size)};
+        if (not this->selected(name))
+          continue;
+        // Don't benchmark what wouldn't fit into the memory available right now.
+        PlainOldData pod;
+        PlainOldData::init(pod);
+        pod.memory_low        = mem;
+        pod.memory_high       = mem;
+        pod.thread_count      = thread_count;
+        pod.thread_batch_size = batch_size;
+        const bool fits {Core::planBatchSize(pod) >= batch_size};
+        PlainOldData::del(pod);
+        if (not fits) {
+          std::fprintf(stderr, "%-32s skipped: not enough available memory\n", name.c_str());
+          continue;
+        }
+        const Summary s {measure(
+         [&]() {
+           const SSC_Error_t err {
+            TSC_kdf(output, salt, password, sizeof(password), thread_count, batch_size, mem, mem, 1, false)};
+           SSC_assertMsg(err != SSC_ERR, "Error: The KDF failed!\n");
+         },
+         warmup,
+         repeats)};
+        Result r {};
+        r.name    = std::move(name);
+        r.group   = "kdf";
+        r.bytes   = thread_count * Core::memoryFromBitShift(mem);
+        r.samples = repeats;
+        r.seconds = s;
+        r.metric  = "seconds_per_gib";
+        r.value   = s.median / (static_cast<double>(r.bytes) / GIBIBYTE);
+        r.higher_is_better = false;
+        this->record(std::move(r));
+      }
+    }
+  }
+  SSC_secureZero(output, sizeof(output));
+}
+
+void Bench::benchEndToEnd(void)
+{
+ #if defined(SSC_OS_UNIXLIKE)
+  const std::string unique {"4crypt-bench-" + std::to_string(static_cast<long>(getpid()))};
+ #else
+  const std::string unique {"4crypt-bench"};
+ #endif
+  const int warmup  {std::min(this->options.warmup, 1)};
+  const int repeats {std::min(this->options.repeats, this->options.quick ? 3 : 7)};
+  const uint64_t size {this->options.file_size};
+  for (const std::string& dir : this->options.dirs) {
+    const std::string label    {std::filesystem::path{dir}.generic_string()};
+    const std::string enc_name {"e2e/encrypt@" + label};
+    const std::string dec_name {"e2e/decrypt@" + label};
+    if (not this->selected(enc_name) and not this->selected(dec_name))
+      continue;
+    const std::string plain_path  {(std::filesystem::path{dir} / (unique + ".in")).string()};
+    const std::string cipher_path {plain_path + ".4c"};
+    const std::string out_path    {(std::filesystem::path{dir} / (unique + ".out")).string()};
+    // Generate the plaintext.
+    {
+      std::FILE* f {std::fopen(plain_path.c_str(), "wb")};
+      if (f == nullptr) {
+        std::fprintf(stderr, "%-32s skipped: cannot write to %s\n", enc_name.c_str(), dir.c_str());
+        continue;
+      }
+      std::vector<uint8_t> chunk (UINT64_C(1) << 20);
+      for (uint64_t written {0}; written < size; written += chunk.size()) {
+        fill_random(chunk.data(), chunk.size());
+        std::fwrite(chunk.data(), 1, std::min<uint64_t>(chunk.size(), size - written), f);
+      }
+      std::fclose(f);
+    }
+    auto run_core = [](const std::string& in, const std::string& out, bool encrypt) {
+      std::remove(out.c_str());
+      Core core {};
+      PlainOldData* pod {core.getPod()};
+      pod->input_filename  = copy_cstr(in , &pod->input_filename_size);
+      pod->output_filename = copy_cstr(out, &pod->output_filename_size);
+      std::memcpy(pod->password_buffer, "4crypt-bench", 12);
+      pod->password_size = 12;
+      pod->memory_low    = E2E_KDF_MEM;
+      pod->memory_high   = E2E_KDF_MEM;
+      PlainOldData::touchup(*pod);
+      Core::ErrType   type {Core::ErrType::CORE};
+      Core::InOutDir  dir  {Core::InOutDir::NONE};
+      const SSC_CodeError_t err {encrypt ? core.encrypt(&type, &dir) : core.decrypt(&type, &dir)};
+      SSC_assertMsg(err == 0, "Error: End-to-end %s of %s failed with code %d!\n", encrypt ? "encryption" : "decryption", in.c_str(), static_cast<int>(err));
+    };
+    // The ciphertext is produced by the encryption runs, so decrypt only after encrypting at least once.
+    const Summary enc {measure([&]() { run_core(plain_path, cipher_path, true); }, warmup, repeats)};
+    if (this->selected(enc_name))
+      this->record(throughput_result(enc_name, "e2e", size, repeats, enc));
+    if (this->selected(dec_name)) {
+      const Summary dec {measure([&]() { run_core(cipher_path, out_path, false); }, warmup, repeats)};
+      this->record(throughput_result(dec_name, "e2e", size, repeats, dec));
+    }
+    std::remove(plain_path.c_str());
+    std::remove(cipher_path.c_str());
+    std::remove(out_path.c_str());
+  }
+}
+
+/* Extract the metric of every result in a JSON document written by Bench::print(), keyed by name. */
+static bool
+load_baseline(const std::string& path, std::map<std::string, double>& values)
+{
+  std::ifstream ifs {path};
+  if (not ifs)
+    return false;
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  const std::string json {ss.str()};
+  static constexpr std::string_view NAME_KEY  {"\"name\":\""};
+  static constexpr std::string_view VALUE_KEY {"\"value\":"};
+  for (size_t pos {json.find(NAME_KEY)}; pos != std::string::npos; pos = json.find(NAME_KEY, pos)) {
+    pos += NAME_KEY.size();
+    const size_t name_end  {json.find('"', pos)};
+    const size_t value_pos {json.find(VALUE_KEY, pos)};
+    if (name_end == std::string::npos or value_pos == std::string::npos)
+      return false;
+    values[json.substr(pos, name_end - pos)] = std::strtod(json.c_str() + value_pos + VALUE_KEY.size(), nullptr);
+  }
+  return not values.empty();
+}
+
+int Bench::compare(const std::string& path, double tolerance, std::FILE* report) const
+{
+  std::map<std::string, double> baseline;
+  if (not load_baseline(path, baseline))
+    return -1;
+  int regressions {0};
+  for (const Result& r : this->results) {
+    const auto it {baseline.find(r.name)};
+    if (it == baseline.end() or it->second <= 0.0)
+      continue;
+    // Positive change is an improvement, whichever direction the metric improves in.
+    const double change {r.higher_is_better ? (r.value / it->second) - 1.0 : (it->second / r.value) - 1.0};
+    const bool   regressed {change < -tolerance};
+    if (regressed)
+      ++regressions;
+    std::fprintf(
+     report,
+     "%-32s %14.3f vs %14.3f %s  %+7.1f%%%s\n",
+     r.name.c_str(),
+     r.value,
+     it->second,
+     r.metric,
+     change * 100.0,
+     regressed ? "  REGRESSION" : "");
+  }
+  return regressions;
+}
+
+void Bench::print(std::FILE* f) const
+{
+  const Resources res {Resources::detect()};
+  std::fprintf(
+   f,
+   "{\"version\":%d,\"host\":{\"hostname\":\"%s\",\"processors\":%" PRIu64 ",\"memory_available\":%" PRIu64 "},\"results\":[",
+   VERSION,
+   get_hostname().c_str(),
+   res.usableProcessors(),
+   res.availableMemory());
+  bool first {true};
+  for (const Result& r : this->results) {
+    std::fprintf(
+     f,
+     "%s\n{\"name\":\"%s\",\"group\":\"%s\",\"bytes\":%" PRIu64 ",\"samples\":%d,"
+     "\"seconds\":{\"min\":%.9g,\"median\":%.9g,\"p90\":%.9g,\"p99\":%.9g,\"mean\":%.9g},"
+     "\"metric\":\"%s\",\"value\":%.9g,\"higher_is_better\":%s}",
+     first ? "" : ",",
+     r.name.c_str(),
+     r.group.c_str(),
+     r.bytes,
+     r.samples,
+     r.seconds.min,
+     r.seconds.median,
+     r.seconds.p90,
+     r.seconds.p99,
+     r.seconds.mean,
+     r.metric,
+     r.value,
+     r.higher_is_better ? "true" : "false");
+    first = false;
+  }
+  std::fputs("\n]}\n", f);
+}
+
+#define ARGS_ const int argc, char** R_ argv, const int offset, void* R_ data
+
+static int
+bench_baseline(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Bench::Options*>(dt)->baseline.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+bench_dir(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Bench::Options*>(dt)->dirs.emplace_back(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+bench_file_size(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t mebibytes {parse_integer(ap->to_read, ap->size)};
+     SSC_assertMsg(mebibytes > 0, "Error: Invalid file size '%s'!\n", ap->to_read);
+     static_cast<Bench::Options*>(dt)->file_size = mebibytes << 20;
+     return SSC_OK;
+   });
+}
+
+static int
+bench_filter(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Bench::Options*>(dt)->filter.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+bench_help(const int, char** R_, const int, void* R_)
+{
+  puts(
+   "4crypt-bench: Measure the throughput and latency of 4crypt's primitives and print JSON.\n"
+   "-h, --help             Print help output.\n"
+   "-q, --quick            Fewer sizes, KDF presets and repeats.\n"
+   "--baseline=<filepath>  Compare against JSON results previously written with --output, and exit\n"
+   "                         unsuccessfully on any regression beyond the tolerance; exit with 77 if\n"
+   "                         there is no baseline.\n"
+   "--dir=<path>           Run the end-to-end benchmarks in this directory; may be repeated.\n"
+   "                         Defaults to /dev/shm (if present) and the current directory.\n"
+   "--file-size=<MiB>      Size of the end-to-end input file. Defaults to 64.\n"
+   "--filter=<substring>   Only run benchmarks whose names contain the substring, e.g. ctr/ or kdf/m21.\n"
+   "--output=<filepath>    Write the JSON results here instead of to stdout.\n"
+   "--repeats=<num>        Timed repetitions per benchmark. Defaults to 15.\n"
+   "--tolerance=<percent>  Allowed regression against the baseline. Defaults to 10.\n"
+   "--warmup=<num>         Untimed repetitions per benchmark. Defaults to 2.");
+  exit(EXIT_SUCCESS);
+  return 0; // Suppress compiler warnings.
+}
+
+static int
+bench_output(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Bench::Options*>(dt)->output.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+bench_quick(const int, char** R_ argv, const int offset, void* R_ data)
+{
+  static_cast<Bench::Options*>(data)->quick = true;
+  return SSC_1opt(argv[0][offset]);
+}
+
+static int
+bench_repeats(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t repeats {parse_integer(ap->to_read, ap->size)};
+     SSC_assertMsg(repeats > 0 and repeats <= 100000, "Error: Invalid repeat count '%s'!\n", ap->to_read);
+     static_cast<Bench::Options*>(dt)->repeats = static_cast<int>(repeats);
+     return SSC_OK;
+   });
+}
+
+static int
+bench_tolerance(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const double percent {std::strtod(ap->to_read, nullptr)};
+     SSC_assertMsg(percent > 0.0 and percent < 100.0, "Error: Invalid tolerance '%s'!\n", ap->to_read);
+     static_cast<Bench::Options*>(dt)->tolerance = percent / 100.0;
+     return SSC_OK;
+   });
+}
+
+static int
+bench_warmup(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Bench::Options*>(dt)->warmup = static_cast<int>(std::min<uint64_t>(parse_integer(ap->to_read, ap->size), 1000));
+     return SSC_OK;
+   });
+}
+#undef ARGS_
+
+const std::array<SSC_ArgShort, 2> shorts = {{
+  SSC_ARGSHORT_LITERAL(bench_help,  'h'),
+  SSC_ARGSHORT_LITERAL(bench_quick, 'q'),
+}};
+
+const std::array<SSC_ArgLong, 10> longs = {{
+  SSC_ARGLONG_LITERAL(bench_baseline,  "baseline"),
+  SSC_ARGLONG_LITERAL(bench_dir,       "dir"),
+  SSC_ARGLONG_LITERAL(bench_file_size, "file-size"),
+  SSC_ARGLONG_LITERAL(bench_filter,    "filter"),
+  SSC_ARGLONG_LITERAL(bench_help,      "help"),
+  SSC_ARGLONG_LITERAL(bench_output,    "output"),
+  SSC_ARGLONG_LITERAL(bench_quick,     "quick"),
+  SSC_ARGLONG_LITERAL(bench_repeats,   "repeats"),
+  SSC_ARGLONG_LITERAL(bench_tolerance, "tolerance"),
+  SSC_ARGLONG_LITERAL(bench_warmup,    "warmup"),
+}};
+
+int main(int argc, char* argv[])
+{
+  Bench::Options options {};
+  if (argc > 1) {
+    SSC_processCommandLineArgs(
+     argc - 1,
+     argv + 1,
+     shorts.size(),
+     shorts.data(),
+     longs.size(),
+     longs.data(),
+     &options,
+     nullptr);
+  }
+  Bench bench {options};
+  // Check for the baseline first, so that a gate without one is skipped rather than run.
+  if (not options.baseline.empty() and not std::filesystem::exists(options.baseline)) {
+    std::fprintf(stderr, "No baseline at %s; skipping.\n", options.baseline.c_str());
+    return Bench::EXIT_SKIPPED;
+  }
+  bench.run();
+  std::FILE* f {stdout};
+  if (not options.output.empty()) {
+    f = std::fopen(options.output.c_str(), "w");
+    SSC_assertMsg(f != nullptr, "Error: Failed to open %s for writing!\n", options.output.c_str());
+  }
+  bench.print(f);
+  if (f != stdout)
+    std::fclose(f);
+  if (not options.baseline.empty()) {
+    const int regressions {bench.compare(options.baseline, options.tolerance, stderr)};
+    if (regressions < 0) {
+      std::fprintf(stderr, "Failed to read the baseline at %s!\n", options.baseline.c_str());
+      return EXIT_FAILURE;
+    }
+    if (regressions > 0) {
+      std::fprintf(stderr, "%d performance regression(s) beyond %.1f%%.\n", regressions, options.tolerance * 100.0);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
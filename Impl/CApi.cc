@@ -0,0 +1,535 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "fourcrypt.h"
+#include "Session.hh"
+// C++ STL
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+// C++ C Lib
+#include <cerrno>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+using namespace fourcrypt;
+
+using ExeMode = Core::ExeMode;
+using Phase   = Core::Phase;
+
+static_assert(FOURCRYPT_ERROR_NO_INPUT_FILENAME          == Core::ERROR_NO_INPUT_FILENAME);
+static_assert(FOURCRYPT_ERROR_NO_OUTPUT_FILENAME         == Core::ERROR_NO_OUTPUT_FILENAME);
+static_assert(FOURCRYPT_ERROR_INPUT_MEMMAP_FAILED        == Core::ERROR_INPUT_MEMMAP_FAILED);
+static_assert(FOURCRYPT_ERROR_OUTPUT_MEMMAP_FAILED       == Core::ERROR_OUTPUT_MEMMAP_FAILED);
+static_assert(FOURCRYPT_ERROR_GETTING_INPUT_FILESIZE     == Core::ERROR_GETTING_INPUT_FILESIZE);
+static_assert(FOURCRYPT_ERROR_INPUT_FILESIZE_TOO_SMALL   == Core::ERROR_INPUT_FILESIZE_TOO_SMALL);
+static_assert(FOURCRYPT_ERROR_INVALID_4CRYPT_FILE        == Core::ERROR_INVALID_4CRYPT_FILE);
+static_assert(FOURCRYPT_ERROR_INPUT_SIZE_MISMATCH        == Core::ERROR_INPUT_SIZE_MISMATCH);
+static_assert(FOURCRYPT_ERROR_RESERVED_BYTES_USED        == Core::ERROR_RESERVED_BYTES_USED);
+static_assert(FOURCRYPT_ERROR_OUTPUT_FILE_EXISTS         == Core::ERROR_OUTPUT_FILE_EXISTS);
+static_assert(FOURCRYPT_ERROR_MAC_VALIDATION_FAILED      == Core::ERROR_MAC_VALIDATION_FAILED);
+static_assert(FOURCRYPT_ERROR_KDF_FAILED                 == Core::ERROR_KDF_FAILED);
+static_assert(FOURCRYPT_ERROR_METADATA_VALIDATION_FAILED == Core::ERROR_METADATA_VALIDATION_FAILED);
+static_assert(FOURCRYPT_ERROR_CANCELLED                  == Core::ERROR_CANCELLED);
+static_assert(FOURCRYPT_ERROR_BUFFER_TOO_SMALL           == Core::ERROR_BUFFER_TOO_SMALL);
+static_assert(FOURCRYPT_ERROR_INVALID_PADDING            == Core::ERROR_INVALID_PADDING);
+static_assert(FOURCRYPT_PHASE_MAP_FILES   == static_cast<int>(Phase::MAP_FILES));
+static_assert(FOURCRYPT_PHASE_KDF         == static_cast<int>(Phase::KDF));
+static_assert(FOURCRYPT_PHASE_UNMAP_FILES == static_cast<int>(Phase::UNMAP_FILES));
+static_assert(FOURCRYPT_PHASE_UNMAP_FILES + 1 == static_cast<int>(Phase::COUNT));
+
+struct fourcrypt_session
+ {
+  Session session {};
+ };
+
+struct fourcrypt_options
+ {
+  Session::Job           job           {};
+  fourcrypt_progress_fn* progress_fn   {nullptr};
+  void*                  progress_data {nullptr};
+  fourcrypt_cancel_fn*   cancel_fn     {nullptr};
+  void*                  cancel_data   {nullptr};
+ };
+
+// Ask the cancel callback as often as the Core polls its token; report progress every tenth time.
+constexpr auto     WATCH_INTERVAL       {std::chrono::milliseconds(Core::CANCEL_POLL_MILLISECONDS)};
+constexpr unsigned WATCHES_PER_PROGRESS {10};
+
+/* Report the progress of the job running on @core to @options' callbacks until @finished. */
+static void
+watch_job(Core* core, const fourcrypt_options* options, const std::atomic<bool>* finished)
+{
+  for (unsigned tick {1}; not finished->load(std::memory_order_acquire); ++tick) {
+    std::this_thread::sleep_for(WATCH_INTERVAL);
+    if (options->cancel_fn != nullptr and options->cancel_fn(options->cancel_data))
+      core->getCancelToken()->cancel();
+    if (options->progress_fn == nullptr or tick % WATCHES_PER_PROGRESS != 0)
+      continue;
+    const Core::Progress p {core->getProgress()->load()};
+    if (p.phase != Phase::COUNT)
+      options->progress_fn(options->progress_data, static_cast<fourcrypt_phase>(p.phase), p.bytes_done, p.bytes_total);
+  }
+}
+
+/* Run a buffer job described by @options in @mode on a Core of its own, watched by a thread of
+ * its own when @options has callbacks. No exception may cross into C.
+ */
+static int
+run_buffer_job(
+ fourcrypt_session*       session,
+ const fourcrypt_options* options,
+ ExeMode                  mode,
+ std::span<uint8_t>       output,
+ std::span<const uint8_t> input,
+ uint64_t*                output_size)
+{
+  if (session == nullptr or options == nullptr or not options->job.hasPassword())
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  try {
+    Session::Job job {options->job};
+    job.mode = mode;
+    Core              core     {};
+    std::atomic<bool> finished {false};
+    std::thread       watcher  {};
+    if (options->progress_fn != nullptr or options->cancel_fn != nullptr)
+      watcher = std::thread{&watch_job, &core, options, &finished};
+    const Session::Result res {session->session.runBuffer(job, core, output, input, output_size)};
+    finished.store(true, std::memory_order_release);
+    if (watcher.joinable())
+      watcher.join();
+    return res.code;
+  }
+  catch (const std::bad_alloc&) {
+    return FOURCRYPT_ERROR_OUT_OF_MEMORY;
+  }
+  catch (...) {
+    return FOURCRYPT_ERROR_IO;
+  }
+}
+
+#if defined(SSC_OS_UNIXLIKE)
+/* The bytes of an input file descriptor from its current offset on: mapped if it's a regular file,
+ * otherwise read into @storage. */
+struct FdInput
+ {
+  const uint8_t*       ptr      {nullptr};
+  size_t               size     {0};
+  void*                map      {nullptr};
+  size_t               map_size {0};
+  std::vector<uint8_t> storage  {};
+
+  ~FdInput()
+   {
+    if (map != nullptr)
+      munmap(map, map_size);
+   }
+ };
+
+/* mmap() offsets must be page aligned; the page of @offset. */
+static off_t
+page_floor(off_t offset)
+{
+  const off_t page {static_cast<off_t>(sysconf(_SC_PAGESIZE))};
+  return offset - (offset % page);
+}
+
+static int
+read_input_fd(int fd, FdInput* in)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return FOURCRYPT_ERROR_IO;
+  if (S_ISREG(st.st_mode)) {
+    // Like read(), start at the current offset and leave it at the end of the file.
+    const off_t offset {lseek(fd, 0, SEEK_CUR)};
+    if (offset < 0)
+      return FOURCRYPT_ERROR_IO;
+    if (offset >= st.st_size)
+      return FOURCRYPT_OK;
+    const off_t map_offset {page_floor(offset)};
+    in->map_size = static_cast<size_t>(st.st_size - map_offset);
+    void* p {mmap(nullptr, in->map_size, PROT_READ, MAP_PRIVATE, fd, map_offset)};
+    if (p == MAP_FAILED)
+      return FOURCRYPT_ERROR_IO;
+    in->map  = p;
+    in->ptr  = static_cast<const uint8_t*>(p) + (offset - map_offset);
+    in->size = static_cast<size_t>(st.st_size - offset);
+    if (lseek(fd, st.st_size, SEEK_SET) < 0)
+      return FOURCRYPT_ERROR_IO;
+    return FOURCRYPT_OK;
+  }
+  constexpr size_t CHUNK {UINT64_C(1) << 16};
+  for (;;) {
+    const size_t used {in->storage.size()};
+    in->storage.resize(used + CHUNK);
+    const ssize_t n {read(fd, in->storage.data() + used, CHUNK)};
+    if (n < 0 and errno == EINTR) {
+      in->storage.resize(used);
+      continue;
+    }
+    if (n < 0)
+      return FOURCRYPT_ERROR_IO;
+    in->storage.resize(used + static_cast<size_t>(n));
+    if (n == 0)
+      break;
+  }
+  in->ptr  = in->storage.data();
+  in->size = in->storage.size();
+  return FOURCRYPT_OK;
+}
+
+static int
+write_all_fd(int fd, const uint8_t* p, size_t n)
+{
+  while (n != 0) {
+    const ssize_t w {write(fd, p, n)};
+    if (w < 0 and errno == EINTR)
+      continue;
+    if (w <= 0)
+      return FOURCRYPT_ERROR_IO;
+    p += w;
+    n -= static_cast<size_t>(w);
+  }
+  return FOURCRYPT_OK;
+}
+
+/* Run a job from @input_fd to @output_fd. The output of a regular file starts at its current offset, or at
+ * its end if it was opened with O_APPEND; the file is sized to hold @capacity bytes past that point and
+ * mapped, so the job writes straight into the page cache. It's then synchronized and truncated at the end
+ * of the actual output, or back to where the output began if the job failed, and the offset is left at
+ * its end. Other outputs are written from a buffer once the job succeeds.
+ */
+static int
+run_fd_job(fourcrypt_session* session, const fourcrypt_options* options, ExeMode mode, int input_fd, int output_fd)
+{
+  if (session == nullptr or options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  FdInput in {};
+  int     err {read_input_fd(input_fd, &in)};
+  if (err)
+    return err;
+  uint64_t capacity;
+  if (mode == ExeMode::ENCRYPT) {
+    capacity = Core::getEncryptedSize(in.size, options->job.padding_size, options->job.padding_mode);
+    if (capacity == 0)
+      return FOURCRYPT_ERROR_INVALID_PADDING;
+  }
+  else {
+    capacity = Core::getDecryptedSizeBound(in.size);
+    if (capacity == 0)
+      return FOURCRYPT_ERROR_INPUT_FILESIZE_TOO_SMALL;
+  }
+  uint64_t    output_size {0};
+  struct stat st;
+  if (fstat(output_fd, &st) != 0)
+    return FOURCRYPT_ERROR_IO;
+  if (S_ISREG(st.st_mode)) {
+    const int flags {fcntl(output_fd, F_GETFL)};
+    if (flags < 0)
+      return FOURCRYPT_ERROR_IO;
+    const off_t offset {(flags & O_APPEND) ? st.st_size : lseek(output_fd, 0, SEEK_CUR)};
+    if (offset < 0)
+      return FOURCRYPT_ERROR_IO;
+    const off_t  map_offset {page_floor(offset)};
+    const size_t lead       {static_cast<size_t>(offset - map_offset)};
+    const size_t map_size   {lead + static_cast<size_t>(capacity)};
+    if (ftruncate(output_fd, offset + static_cast<off_t>(capacity)) != 0)
+      return FOURCRYPT_ERROR_IO;
+    void* p {mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, output_fd, map_offset)};
+    if (p == MAP_FAILED) {
+      (void)ftruncate(output_fd, offset);
+      return FOURCRYPT_ERROR_IO;
+    }
+    uint8_t* const out {static_cast<uint8_t*>(p) + lead};
+    err = run_buffer_job(session, options, mode, {out, capacity}, {in.ptr, in.size}, &output_size);
+    if (err == FOURCRYPT_OK and msync(p, map_size, MS_SYNC) != 0)
+      err = FOURCRYPT_ERROR_IO;
+    munmap(p, map_size);
+    const off_t end {offset + static_cast<off_t>(err == FOURCRYPT_OK ? output_size : 0)};
+    if (ftruncate(output_fd, end) != 0 and err == FOURCRYPT_OK)
+      err = FOURCRYPT_ERROR_IO;
+    if (lseek(output_fd, end, SEEK_SET) < 0 and err == FOURCRYPT_OK)
+      err = FOURCRYPT_ERROR_IO;
+    return err;
+  }
+  std::unique_ptr<uint8_t[]> buffer {new (std::nothrow) uint8_t[capacity]};
+  if (buffer == nullptr)
+    return FOURCRYPT_ERROR_OUT_OF_MEMORY;
+  err = run_buffer_job(session, options, mode, {buffer.get(), capacity}, {in.ptr, in.size}, &output_size);
+  if (err == FOURCRYPT_OK)
+    err = write_all_fd(output_fd, buffer.get(), output_size);
+  // A decrypted buffer holds plaintext.
+  SSC_secureZero(buffer.get(), capacity);
+  return err;
+}
+#endif
+
+extern "C" {
+
+int
+fourcrypt_abi_version(void)
+{
+  return FOURCRYPT_ABI_VERSION;
+}
+
+const char*
+fourcrypt_strerror(int error)
+{
+  switch (error) {
+    case FOURCRYPT_OK:                               return "Success.";
+    case FOURCRYPT_ERROR_NO_INPUT_FILENAME:          return "No input file provided.";
+    case FOURCRYPT_ERROR_NO_OUTPUT_FILENAME:         return "No output file provided.";
+    case FOURCRYPT_ERROR_INPUT_MEMMAP_FAILED:        return "Failed to memory-map the input file.";
+    case FOURCRYPT_ERROR_OUTPUT_MEMMAP_FAILED:       return "Failed to memory-map the output file.";
+    case FOURCRYPT_ERROR_GETTING_INPUT_FILESIZE:     return "Failed to get the size of the input file.";
+    case FOURCRYPT_ERROR_INPUT_FILESIZE_TOO_SMALL:   return "The input is too small to be 4crypt-encrypted.";
+    case FOURCRYPT_ERROR_INVALID_4CRYPT_FILE:        return "The input is not 4crypt-encrypted.";
+    case FOURCRYPT_ERROR_INPUT_SIZE_MISMATCH:        return "The size recorded in the header does not match the size of the input.";
+    case FOURCRYPT_ERROR_RESERVED_BYTES_USED:        return "Reserved bytes of the input were used.";
+    case FOURCRYPT_ERROR_OUTPUT_FILE_EXISTS:         return "The output file already exists.";
+    case FOURCRYPT_ERROR_MAC_VALIDATION_FAILED:      return "Failed to validate the Message Authentication Code; wrong password, or corrupted or modified input.";
+    case FOURCRYPT_ERROR_KDF_FAILED:                 return "Failed to compute the key derivation function; not enough memory is available.";
+    case FOURCRYPT_ERROR_METADATA_VALIDATION_FAILED: return "Failed to validate the input's metadata.";
+    case FOURCRYPT_ERROR_CANCELLED:                  return "The operation was cancelled.";
+    case FOURCRYPT_ERROR_BUFFER_TOO_SMALL:           return "The output buffer is too small.";
+    case FOURCRYPT_ERROR_INVALID_PADDING:            return "The requested padding is smaller than the input.";
+    case FOURCRYPT_ERROR_INVALID_ARGUMENT:           return "Invalid argument.";
+    case FOURCRYPT_ERROR_OUT_OF_MEMORY:              return "Out of memory.";
+    case FOURCRYPT_ERROR_IO:                         return "Input/output error.";
+    case FOURCRYPT_ERROR_UNSUPPORTED:                return "Not supported on this platform.";
+    default:                                         return "Unknown error.";
+  }
+}
+
+fourcrypt_session*
+fourcrypt_session_new(void)
+{
+  return new (std::nothrow) fourcrypt_session{};
+}
+
+void
+fourcrypt_session_free(fourcrypt_session* session)
+{
+  delete session;
+}
+
+fourcrypt_options*
+fourcrypt_options_new(void)
+{
+  return new (std::nothrow) fourcrypt_options{};
+}
+
+void
+fourcrypt_options_free(fourcrypt_options* options)
+{
+  delete options;
+}
+
+int
+fourcrypt_options_set_password(fourcrypt_options* options, const void* password, size_t size)
+{
+  if (options == nullptr or password == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  return options->job.setPassword(password, size) ? FOURCRYPT_OK : FOURCRYPT_ERROR_INVALID_ARGUMENT;
+}
+
+int
+fourcrypt_options_set_preset(fourcrypt_options* options, fourcrypt_preset preset)
+{
+  if (options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  switch (preset) {
+    case FOURCRYPT_PRESET_NONE:   options->job.preset = Session::Preset::NONE;   break;
+    case FOURCRYPT_PRESET_FAST:   options->job.preset = Session::Preset::FAST;   break;
+    case FOURCRYPT_PRESET_NORMAL: options->job.preset = Session::Preset::NORMAL; break;
+    case FOURCRYPT_PRESET_STRONG: options->job.preset = Session::Preset::STRONG; break;
+    default:
+      return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_memory(fourcrypt_options* options, uint64_t bytes)
+{
+  if (options == nullptr or bytes < Core::memoryFromBitShift(0) or (bytes & (bytes - 1)) != 0)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  uint8_t bitshift {0};
+  while (Core::memoryFromBitShift(bitshift) != bytes)
+    ++bitshift;
+  options->job.memory_low  = bitshift;
+  options->job.memory_high = bitshift;
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_iterations(fourcrypt_options* options, unsigned iterations)
+{
+  if (options == nullptr or iterations == 0 or iterations > UINT8_MAX)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  options->job.iterations = static_cast<uint8_t>(iterations);
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_threads(fourcrypt_options* options, uint64_t threads, uint64_t batch_size)
+{
+  if (options == nullptr or threads == 0 or batch_size > threads)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  options->job.thread_count      = threads;
+  options->job.thread_batch_size = batch_size;
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_phi(fourcrypt_options* options, int enable)
+{
+  if (options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  if (enable)
+    options->job.flags |= Core::ENABLE_PHI;
+  else
+    options->job.flags &= ~Core::ENABLE_PHI;
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_padding(fourcrypt_options* options, uint64_t size, fourcrypt_pad_mode mode)
+{
+  if (options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  switch (mode) {
+    case FOURCRYPT_PAD_ADD:    options->job.padding_mode = Core::PadMode::ADD;    break;
+    case FOURCRYPT_PAD_TARGET: options->job.padding_mode = Core::PadMode::TARGET; break;
+    case FOURCRYPT_PAD_AS_IF:  options->job.padding_mode = Core::PadMode::AS_IF;  break;
+    default:
+      return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+  options->job.padding_size = size;
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_progress_callback(fourcrypt_options* options, fourcrypt_progress_fn* fn, void* user_data)
+{
+  if (options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  options->progress_fn   = fn;
+  options->progress_data = user_data;
+  return FOURCRYPT_OK;
+}
+
+int
+fourcrypt_options_set_cancel_callback(fourcrypt_options* options, fourcrypt_cancel_fn* fn, void* user_data)
+{
+  if (options == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  options->cancel_fn   = fn;
+  options->cancel_data = user_data;
+  return FOURCRYPT_OK;
+}
+
+uint64_t
+fourcrypt_encrypted_size(const fourcrypt_options* options, uint64_t plaintext_size)
+{
+  if (options == nullptr)
+    return Core::getEncryptedSize(plaintext_size);
+  return Core::getEncryptedSize(plaintext_size, options->job.padding_size, options->job.padding_mode);
+}
+
+uint64_t
+fourcrypt_decrypted_size_bound(uint64_t ciphertext_size)
+{
+  return Core::getDecryptedSizeBound(ciphertext_size);
+}
+
+int
+fourcrypt_encrypt_buffer(
+ fourcrypt_session*       session,
+ const fourcrypt_options* options,
+ const void*              input,
+ size_t                   input_size,
+ void*                    output,
+ size_t                   output_capacity,
+ size_t*                  output_size)
+{
+  if ((input == nullptr and input_size != 0) or output == nullptr or output_size == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  uint64_t size {0};
+  const int err {run_buffer_job(
+   session,
+   options,
+   ExeMode::ENCRYPT,
+   {static_cast<uint8_t*>(output), output_capacity},
+   {static_cast<const uint8_t*>(input), input_size},
+   &size)};
+  *output_size = static_cast<size_t>(size);
+  return err;
+}
+
+int
+fourcrypt_decrypt_buffer(
+ fourcrypt_session*       session,
+ const fourcrypt_options* options,
+ const void*              input,
+ size_t                   input_size,
+ void*                    output,
+ size_t                   output_capacity,
+ size_t*                  output_size)
+{
+  if (input == nullptr or output == nullptr or output_size == nullptr)
+    return FOURCRYPT_ERROR_INVALID_ARGUMENT;
+  uint64_t size {0};
+  const int err {run_buffer_job(
+   session,
+   options,
+   ExeMode::DECRYPT,
+   {static_cast<uint8_t*>(output), output_capacity},
+   {static_cast<const uint8_t*>(input), input_size},
+   &size)};
+  *output_size = static_cast<size_t>(size);
+  return err;
+}
+
+int
+fourcrypt_encrypt_fd(fourcrypt_session* session, const fourcrypt_options* options, int input_fd, int output_fd)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  return run_fd_job(session, options, ExeMode::ENCRYPT, input_fd, output_fd);
+#else
+  return FOURCRYPT_ERROR_UNSUPPORTED;
+#endif
+}
+
+int
+fourcrypt_decrypt_fd(fourcrypt_session* session, const fourcrypt_options* options, int input_fd, int output_fd)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  return run_fd_job(session, options, ExeMode::DECRYPT, input_fd, output_fd);
+#else
+  return FOURCRYPT_ERROR_UNSUPPORTED;
+#endif
+}
+
+} // ! extern "C"
@@ -0,0 +1,264 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Calibration.hh"
+#include "Resources.hh"
+#include "Util.hh"
+// SSC
+#include <SSC/Memory.h>
+// TSC
+#include <TSC/Kdf.h>
+// C++ STL
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+// C++ C Lib
+#include <cstdio>
+#include <cstdlib>
+using namespace fourcrypt;
+
+// The memory sweep runs from 4 to 64 Mebibytes per thread.
+constexpr uint8_t  PROBE_MEM_LOW  {16};
+constexpr uint8_t  PROBE_MEM_HIGH {20};
+// Iterations, Phi and concurrency are probed at 16 Mebibytes per thread.
+constexpr uint8_t  PROBE_MEM_REF  {18};
+constexpr uint8_t  PROBE_ITERATIONS {3};
+constexpr uint64_t PROBE_MAX_THREADS {8};
+constexpr int      PROBE_REPETITIONS {3};
+constexpr uint8_t  MAX_MEM_BITSHIFT {50};
+
+/* Run the KDF with throwaway inputs and return the fastest of PROBE_REPETITIONS runs, in seconds. */
+static double
+probe_kdf(uint8_t mem, uint8_t iterations, uint64_t threads, bool phi)
+{
+  alignas(uint64_t) uint8_t salt [TSC_CATENA512_SALT_BYTES] {};
+  uint8_t password [] {'4', 'c', 'r', 'y', 'p', 't'};
+  uint8_t output   [TSC_KDF_OUTPUT_BYTES];
+  double  best {std::numeric_limits<double>::max()};
+  for (int i {0}; i < PROBE_REPETITIONS; ++i) {
+    const auto start {std::chrono::steady_clock::now()};
+    const SSC_Error_t err {TSC_kdf(output, salt, password, sizeof(password), threads, threads, mem, mem, iterations, phi)};
+    const std::chrono::duration<double> elapsed {std::chrono::steady_clock::now() - start};
+    if (err == SSC_ERR)
+      break;
+    best = std::min(best, elapsed.count());
+  }
+  SSC_secureZero(output, sizeof(output));
+  return best;
+}
+
+Calibration
+Calibration::get(bool force_measure)
+{
+  Calibration       cal  {};
+  const std::string path {Calibration::cachePath()};
+  if (not force_measure and not path.empty() and cal.load(path))
+    return cal;
+  cal = Calibration::measure();
+  if (not path.empty())
+    cal.save(path);
+  return cal;
+}
+
+Calibration
+Calibration::measure(void)
+{
+  Calibration cal {};
+  cal.processors   = Resources::detect().usableProcessors();
+  cal.cpu_model    = get_cpu_model();
+  cal.memory_bytes = get_total_memory();
+
+  // Fit @overhead and @seconds_per_byte by least squares over the memory sweep.
+  {
+    double sx {0.0}, sy {0.0}, sxx {0.0}, sxy {0.0};
+    int    n  {0};
+    for (uint8_t mem {PROBE_MEM_LOW}; mem <= PROBE_MEM_HIGH; ++mem, ++n) {
+      const double x {static_cast<double>(Core::memoryFromBitShift(mem))};
+      const double y {probe_kdf(mem, 1, 1, false)};
+      sx  += x;
+      sy  += y;
+      sxx += x * x;
+      sxy += x * y;
+    }
+    cal.seconds_per_byte = ((n * sxy) - (sx * sy)) / ((n * sxx) - (sx * sx));
+    cal.overhead         = std::max((sy - (cal.seconds_per_byte * sx)) / n, 0.0);
+    cal.seconds_per_byte = std::max(cal.seconds_per_byte, std::numeric_limits<double>::min());
+  }
+  // Everything else is measured relative to a single thread iterating once at PROBE_MEM_REF.
+  const double base {std::max(probe_kdf(PROBE_MEM_REF, 1, 1, false) - cal.overhead, 1e-6)};
+  auto relative = [&cal, base](double seconds) -> double {
+    return (seconds - cal.overhead) / base;
+  };
+  cal.iteration_factor = std::max((relative(probe_kdf(PROBE_MEM_REF, PROBE_ITERATIONS, 1, false)) - 1.0) / (PROBE_ITERATIONS - 1), 0.0);
+  cal.phi_factor       = std::max(relative(probe_kdf(PROBE_MEM_REF, 1, 1, true)), 1.0);
+  cal.concurrency_threads = std::min(cal.processors, PROBE_MAX_THREADS);
+  if (cal.concurrency_threads > 1)
+    cal.concurrency_factor = std::max(relative(probe_kdf(PROBE_MEM_REF, 1, cal.concurrency_threads, false)), 1.0);
+  return cal;
+}
+
+/* The cache file is per-host, so that home directories shared between machines
+ * don't mix calibrations of different hardware.
+ */
+std::string
+Calibration::cachePath(void)
+{
+  std::string dir {};
+#if defined(SSC_OS_WINDOWS)
+  if (const char* local {std::getenv("LOCALAPPDATA")}; local != nullptr)
+    dir = std::string{local} + "\\4crypt";
+#else
+  if (const char* xdg {std::getenv("XDG_CACHE_HOME")}; xdg != nullptr && xdg[0] != '\0')
+    dir = std::string{xdg} + "/4crypt";
+  else if (const char* home {std::getenv("HOME")}; home != nullptr && home[0] != '\0')
+    dir = std::string{home} + "/.cache/4crypt";
+#endif
+  if (dir.empty())
+    return dir;
+  return (std::filesystem::path{dir} / ("calibration-" + get_hostname())).string();
+}
+
+uint64_t
+Calibration::defaultMemoryBudget(void)
+{
+  const uint64_t available {Resources::detect().availableMemory()};
+  if (available == 0)
+    return Core::memoryFromBitShift(Core::MEM_STRONG);
+  return available / 2;
+}
+
+bool
+Calibration::load(const std::string& path)
+{
+  std::ifstream in {path};
+  if (not in)
+    return false;
+  Calibration cal     {};
+  int         version {0};
+  std::string key     {};
+  while (in >> key) {
+    if      (key == "version")             in >> version;
+    else if (key == "overhead")            in >> cal.overhead;
+    else if (key == "seconds_per_byte")    in >> cal.seconds_per_byte;
+    else if (key == "iteration_factor")    in >> cal.iteration_factor;
+    else if (key == "phi_factor")          in >> cal.phi_factor;
+    else if (key == "concurrency_factor")  in >> cal.concurrency_factor;
+    else if (key == "concurrency_threads") in >> cal.concurrency_threads;
+    else if (key == "processors")          in >> cal.processors;
+    else if (key == "cpu_model")           in >> cal.cpu_model;
+    else if (key == "memory_bytes")        in >> cal.memory_bytes;
+    else
+      return false;
+  }
+  // Stale or foreign calibrations must be re-measured.
+  if (version != VERSION or cal.seconds_per_byte <= 0.0)
+    return false;
+  if (cal.processors != Resources::detect().usableProcessors())
+    return false;
+  // e.g. a VM resized, or a home directory shared by hosts of the same name.
+  if (cal.cpu_model != get_cpu_model() or cal.memory_bytes != get_total_memory())
+    return false;
+  *this = cal;
+  return true;
+}
+
+bool
+Calibration::save(const std::string& path) const
+{
+  std::error_code ec {};
+  const std::filesystem::path p {path};
+  std::filesystem::create_directories(p.parent_path(), ec);
+  if (ec)
+    return false;
+  // Write to a temporary file and rename it into place, so concurrent runs never read half a file.
+  const std::string tmp {path + ".tmp"};
+  {
+    std::ofstream out {tmp, std::ios::trunc};
+    if (not out)
+      return false;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << "version "             << VERSION             << '\n'
+        << "overhead "            << overhead            << '\n'
+        << "seconds_per_byte "    << seconds_per_byte    << '\n'
+        << "iteration_factor "    << iteration_factor    << '\n'
+        << "phi_factor "          << phi_factor          << '\n'
+        << "concurrency_factor "  << concurrency_factor  << '\n'
+        << "concurrency_threads " << concurrency_threads << '\n'
+        << "processors "          << processors          << '\n'
+        << "cpu_model "           << cpu_model           << '\n'
+        << "memory_bytes "        << memory_bytes        << '\n';
+    if (not out)
+      return false;
+  }
+  std::filesystem::rename(tmp, p, ec);
+  return not ec;
+}
+
+double
+Calibration::predict(uint8_t mem_bitshift, uint8_t iterations, uint64_t threads, uint64_t batch_size, bool phi) const
+{
+  if (batch_size == 0 || batch_size > threads)
+    batch_size = threads;
+  const uint64_t rounds {(threads + batch_size - 1) / batch_size};
+  double concurrency {1.0};
+  if (concurrency_threads > 1)
+    concurrency += (concurrency_factor - 1.0) * static_cast<double>(batch_size - 1) / static_cast<double>(concurrency_threads - 1);
+  double seconds {seconds_per_byte * static_cast<double>(Core::memoryFromBitShift(mem_bitshift))};
+  seconds *= 1.0 + (iteration_factor * (iterations - 1));
+  if (phi)
+    seconds *= phi_factor;
+  seconds *= concurrency;
+  return overhead + (static_cast<double>(rounds) * seconds);
+}
+
+void
+Calibration::tune(Pod_t& pod, double target_seconds, uint64_t max_memory, uint8_t min_mem_bitshift) const
+{
+  const bool phi {static_cast<bool>(pod.flags & Core::ENABLE_PHI)};
+  // Fall back to the weakest acceptable parameters if nothing fits.
+  uint8_t  best_mem        {min_mem_bitshift};
+  uint64_t best_threads    {1};
+  uint8_t  best_iterations {1};
+  double   best_score      {0.0};
+  for (uint8_t mem {min_mem_bitshift}; mem <= MAX_MEM_BITSHIFT; ++mem) {
+    const uint64_t bytes {Core::memoryFromBitShift(mem)};
+    if (bytes > max_memory || this->predict(mem, 1, 1, 1, phi) > target_seconds)
+      break;
+    for (uint64_t threads {1}; threads <= processors && (bytes * threads) <= max_memory; ++threads) {
+      // Spend whatever time remains on iterations.
+      unsigned iterations {0};
+      while (iterations < 255 && this->predict(mem, static_cast<uint8_t>(iterations + 1), threads, threads, phi) <= target_seconds)
+        ++iterations;
+      if (iterations == 0)
+        break;
+      const double m     {static_cast<double>(bytes)};
+      const double score {static_cast<double>(threads) * m * m * iterations};
+      if (score > best_score) {
+        best_score      = score;
+        best_mem        = mem;
+        best_threads    = threads;
+        best_iterations = static_cast<uint8_t>(iterations);
+      }
+    }
+  }
+  pod.memory_low        = best_mem;
+  pod.memory_high       = best_mem;
+  pod.thread_count      = best_threads;
+  pod.thread_batch_size = best_threads;
+  pod.iterations        = best_iterations;
+}
@@ -17,11 +17,19 @@
 // Local
 #include "Core.hh"
 #include "CommandLineArg.hh"
+#include "PerfCounters.hh"
+#include "Stats.hh"
 // SSC
 #include <SSC/Macro.h>
 #include <SSC/CommandLineArg.h>
 // C++ STL
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+// C++ C Lib
+#include <csignal>
 using namespace fourcrypt;
 
 
@@ -30,6 +38,8 @@ using ErrType = Core::ErrType;
 using InOutDir = Core::InOutDir;
 using ExeMode  = Core::ExeMode;
 using PadMode  = Core::PadMode;
+using Phase    = Core::Phase;
+using ReportFormat = Core::ReportFormat;
 
 const std::array<SSC_ArgShort, 14> shorts = {{
   SSC_ARGSHORT_LITERAL(ArgProc::enter_password_once, '1'),
@@ -48,7 +58,9 @@ const std::array<SSC_ArgShort, 14> shorts = {{
   SSC_ARGSHORT_LITERAL(ArgProc::output,              'o'),
 }};
 
-const std::array<SSC_ArgLong, 21> longs = {{
+const std::array<SSC_ArgLong, 34> longs = {{
+  SSC_ARGLONG_LITERAL(ArgProc::affinity,            "affinity"),
+  SSC_ARGLONG_LITERAL(ArgProc::agent,               "agent"),
   SSC_ARGLONG_LITERAL(ArgProc::batch_size,          "batch-size"),
   SSC_ARGLONG_LITERAL(ArgProc::decrypt,             "decrypt"),
   SSC_ARGLONG_LITERAL(ArgProc::describe,            "describe"),
@@ -62,16 +74,94 @@ const std::array<SSC_ArgLong, 21> longs = {{
   SSC_ARGLONG_LITERAL(ArgProc::iterations,          "iterations"),
   SSC_ARGLONG_LITERAL(ArgProc::low_mem,             "low-mem"),
   SSC_ARGLONG_LITERAL(ArgProc::low_mem,             "low-memory"),
+  SSC_ARGLONG_LITERAL(ArgProc::max_memory,          "max-memory"),
+  SSC_ARGLONG_LITERAL(ArgProc::metrics,             "metrics"),
+  SSC_ARGLONG_LITERAL(ArgProc::numa,                "numa"),
   SSC_ARGLONG_LITERAL(ArgProc::output,              "output"),
   SSC_ARGLONG_LITERAL(ArgProc::pad_as_if,           "pad-as-if"),
   SSC_ARGLONG_LITERAL(ArgProc::pad_by,              "pad-by"),
   SSC_ARGLONG_LITERAL(ArgProc::pad_to,              "pad-to"),
+  SSC_ARGLONG_LITERAL(ArgProc::profile,             "profile"),
+  SSC_ARGLONG_LITERAL(ArgProc::progress,            "progress"),
+  SSC_ARGLONG_LITERAL(ArgProc::show_resources,      "show-resources"),
+  SSC_ARGLONG_LITERAL(ArgProc::small_file_limit,    "small-file-limit"),
+  SSC_ARGLONG_LITERAL(ArgProc::stats,               "stats"),
+  SSC_ARGLONG_LITERAL(ArgProc::target_time,         "target-time"),
   SSC_ARGLONG_LITERAL(ArgProc::threads,             "threads"),
+  SSC_ARGLONG_LITERAL(ArgProc::trace,               "trace"),
   SSC_ARGLONG_LITERAL(ArgProc::use_mem,             "use-mem"),
   SSC_ARGLONG_LITERAL(ArgProc::use_mem,             "use-memory"),
   SSC_ARGLONG_LITERAL(ArgProc::use_phi,             "use-phi"),
+  SSC_ARGLONG_LITERAL(ArgProc::verify,              "verify"),
 }};
 
+/* Poll @core's progress until @finished is set, rewriting a single line of stderr. Nothing is printed
+ * before the password has been entered, so as not to interfere with the prompt.
+ */
+static void progress_thread(Core* core, const std::atomic<bool>* finished)
+{
+  using Clock_t = std::chrono::steady_clock;
+  constexpr auto INTERVAL {std::chrono::milliseconds(100)};
+  const Clock_t::time_point start {Clock_t::now()};
+  Clock_t::time_point bytes_start {};
+  uint64_t            bytes_start_done {0};
+  bool                bytes_started {false};
+  bool                printed {false};
+  while (not finished->load(std::memory_order_acquire)) {
+    std::this_thread::sleep_for(INTERVAL);
+    const Core::Progress p {core->getProgress()->load()};
+    if (p.phase == Phase::COUNT or p.phase == Phase::MAP_FILES or p.phase == Phase::PASSWORD)
+      continue;
+    const Clock_t::time_point now {Clock_t::now()};
+    const Core::KdfProgress*  kdf {core->getKdfProgress()};
+    if (p.phase == Phase::KDF and kdf->estimatedFraction() >= 0.0) {
+      const double left {std::max(kdf->predicted_seconds.load(std::memory_order_relaxed) - kdf->elapsedSeconds(), 0.0)};
+      std::fprintf(stderr, "\r%-11s ~%4.1f%% (predicted)  ETA %6.1fs%10s", Core::phaseName(p.phase), 100.0 * kdf->estimatedFraction(), left, "");
+    }
+    else if (p.bytes_done == 0 or p.bytes_total == 0) {
+      const double elapsed {std::chrono::duration<double>(now - start).count()};
+      std::fprintf(stderr, "\r%-11s %7.1fs elapsed%30s", Core::phaseName(p.phase), elapsed, "");
+    }
+    else {
+      if (not bytes_started) {
+        // Measure throughput from the first byte onward, excluding the KDF.
+        bytes_started    = true;
+        bytes_start      = now;
+        bytes_start_done = p.bytes_done;
+      }
+      const double seconds {std::chrono::duration<double>(now - bytes_start).count()};
+      const double rate    {seconds > 0.0 ? static_cast<double>(p.bytes_done - bytes_start_done) / seconds : 0.0};
+      const double percent {100.0 * static_cast<double>(p.bytes_done) / static_cast<double>(p.bytes_total)};
+      if (rate > 0.0)
+        std::fprintf(
+         stderr,
+         "\r%-11s %5.1f%% %10.1f MiB/s  ETA %6.1fs   ",
+         Core::phaseName(p.phase),
+         percent,
+         rate / (1024.0 * 1024.0),
+         static_cast<double>(p.bytes_total - p.bytes_done) / rate);
+      else
+        std::fprintf(stderr, "\r%-11s %5.1f%%%35s", Core::phaseName(p.phase), percent, "");
+    }
+    printed = true;
+  }
+  if (printed)
+    std::fputc('\n', stderr);
+}
+
+/* SIGINT and SIGTERM cancel the ongoing operation, so that it removes its partial output before exiting.
+ * A second signal terminates the process as usual.
+ */
+static Core::CancelToken* signal_cancel_token {nullptr};
+static_assert(std::atomic<bool>::is_always_lock_free, "Cancelling from a signal handler requires a lock-free flag!");
+
+static void on_cancel_signal(int sig)
+{
+  std::signal(sig, SIG_DFL);
+  if (signal_cancel_token != nullptr)
+    signal_cancel_token->cancel();
+}
+
 static void handle_core_errors(PlainOldData* pod, SSC_CodeError_t err, InOutDir err_io_dir)
 {
   switch (err) {
@@ -108,6 +198,21 @@ static void handle_core_errors(PlainOldData* pod, SSC_CodeError_t err, InOutDir
     case (Core::ERROR_MAC_VALIDATION_FAILED):
       SSC_errx("Failed to validate the MAC!\n");
       break;
+    case (Core::ERROR_KDF_FAILED):
+      SSC_errx("Failed to compute the KDF! Not enough memory is available, even for one KDF thread at a time.\n");
+      break;
+    case (Core::ERROR_METADATA_VALIDATION_FAILED):
+      SSC_errx("Failed to validate the input file's metadata!\n");
+      break;
+    case (Core::ERROR_CANCELLED):
+      SSC_errx("The operation was cancelled.\n");
+      break;
+    case (Core::ERROR_BUFFER_TOO_SMALL):
+      SSC_errx("The output buffer is too small!\n");
+      break;
+    case (Core::ERROR_INVALID_PADDING):
+      SSC_errx("The requested padding is smaller than the input!\n");
+      break;
     default:
       SSC_errx("Unaccounted for code_error code in pod, %d.\n", err);
   }
@@ -184,9 +289,31 @@ int main(int argc, char* argv[])
   SSC_CodeError_t code_error  = 0;
   ErrType         code_type   = ErrType::CORE;
   InOutDir        code_io_dir = InOutDir::NONE;
-  
+  Stats           stats {};
+  PerfCounters    counters {};
+  if (pod->flags & Core::PROFILE_COUNTERS) {
+    if (pod->stats_format == ReportFormat::NONE)
+      pod->stats_format = ReportFormat::TEXT;
+    // Open the counters before the KDF spawns its threads, so that they inherit them.
+    if (counters.open())
+      stats.setCounters(&counters);
+    else
+      std::fputs("Performance counters are unavailable (is perf_event_paranoid too high?); reporting timings only.\n", stderr);
+  }
+  if (pod->stats_format != ReportFormat::NONE)
+    core.setStats(&stats);
+  std::atomic<bool> finished {false};
+  std::thread       progress {};
+  if ((pod->flags & Core::SHOW_PROGRESS) and pod->execute_mode != ExeMode::DESCRIBE)
+    progress = std::thread{&progress_thread, &core, &finished};
+  signal_cancel_token = core.getCancelToken();
+  std::signal(SIGINT, &on_cancel_signal);
+  std::signal(SIGTERM, &on_cancel_signal);
+
   switch (pod->execute_mode) {
     case ExeMode::ENCRYPT:
+      if (pod->target_seconds > 0.0)
+        PlainOldData::set_calibrated(*pod);
       PlainOldData::touchup(*pod);
       code_error = core.encrypt(&code_type, &code_io_dir);
       break;
@@ -196,9 +323,16 @@ int main(int argc, char* argv[])
     case ExeMode::DESCRIBE:
       code_error = core.describe(&code_type, &code_io_dir);
       break;
+    case ExeMode::VERIFY:
+      code_error = core.verify(&code_type, &code_io_dir);
+      break;
     default:
       SSC_errx("Invalid execute_mode in pod.\n");
   }
+  finished.store(true, std::memory_order_release);
+  if (progress.joinable())
+    progress.join();
+  stats.print(stderr, pod->stats_format);
   if (code_error == 0)
     return EXIT_SUCCESS;
   switch (code_type) {
@@ -15,20 +15,26 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "CommandLineArg.hh"
+#include "Executor.hh"
+#include "Resources.hh"
+#include "Metrics.hh"
+#include "Trace.hh"
 #include "Util.hh"
 #include <SSC/SSC_String.h>
 // C++ C Lib
 #include <cinttypes>
+#include <cstdlib>
 #define R_ SSC_RESTRICT
 using namespace fourcrypt;
 
 
 using ExeMode = Core::ExeMode;
 using PadMode = Core::PadMode;
+using ReportFormat = Core::ReportFormat;
 using PlainOldData = Core::PlainOldData;
 
 static const char* mode_strings[] = {
-  "NONE", "ENCRYPT", "DECRYPT", "DESCRIBE"
+  "NONE", "ENCRYPT", "DECRYPT", "DESCRIBE", "VERIFY"
 };
 
 static int
@@ -69,10 +75,6 @@ set_padmode(
   ctx->padding_mode = pm;
 }
 
-constexpr uint64_t KIBIBYTE = 1024;
-constexpr uint64_t MEBIBYTE = KIBIBYTE * KIBIBYTE;
-constexpr uint64_t GIBIBYTE = MEBIBYTE * KIBIBYTE;
-
 SSC_INLINE uint64_t
 parse_threads(const char* R_ str, const size_t len)
 {
@@ -85,35 +87,6 @@ parse_batch(const char* R_ str, const size_t len)
   return parse_integer(str, len);
 }
 
-static uint64_t
-parse_padding(const char* R_ str, const size_t len)
-{
-  char* const temp = new char[len + 1];
-  memcpy(temp, str, len + 1);
-  uint64_t multiplier = 1;
-  for (size_t i = 0; i < len; ++i) {
-    switch (toupper(static_cast<unsigned char>(str[i]))) {
-      case 'K':
-        multiplier = KIBIBYTE;
-        goto have_multiplier;
-      case 'M':
-        multiplier = MEBIBYTE;
-        goto have_multiplier;
-      case 'G':
-        multiplier = GIBIBYTE;
-        goto have_multiplier;
-    }
-  }
-  uint64_t num_digits;
-have_multiplier:
-  num_digits = SSC_Cstr_shiftDigitsToFront(temp, len);
-  SSC_assertMsg(num_digits > 0, "Asked for 0 padding?");
-  uint64_t padding = static_cast<uint64_t>(strtoumax(temp, nullptr, 10));
-  delete[] temp;
-  SSC_assertMsg((padding * multiplier) >= padding, "padding < padding * multiplier... Overflow?\n");
-  return padding * multiplier;
-}
-
 static void
 print_help()
 {
@@ -125,6 +98,8 @@ print_help()
    "-e, --encrypt=<filepath>    Encrypt the file at the filepath.\n"
    "-d, --decrypt=<filepath>    Decrypt the file at the filepath.\n"
    "-D, --describe=<filepath>   Describe the header of encrypted file at the filepath.\n"
+   "--verify=<filepath>         Check the password and integrity of the encrypted file at the filepath,\n"
+   "                              without writing anything.\n"
    "-o, --output=<filepath>     Specify an output filepath.\n"
    "-E, --entropy               Provide additional entropy to the RNG from stdin.\n"
    "-H, --high-mem=<mem[K|M|G]> Provide an upper memory bound for key derivation.\n"
@@ -135,6 +110,29 @@ print_help()
    "-B, --batch-size=<num>      Set the number of KDF threads to execute concurrently.\n"
    "-1, --enter-password-once   Disable password-reentry for correctness verification during encryption.\n"
    "-P, --use-phi               Enable the Phi function for each KDF thread.\n"
+   "--affinity=<compact|scatter>\n"
+   "                            Pin the threads applying the keystream one per processor, filling cores and\n"
+   "                              sockets in turn (compact) or spreading across them (scatter).\n"
+   "--agent                     Reuse the key of a recently opened file from 4crypt-agent instead of running\n"
+   "                              the KDF again, and hand newly derived keys to it.\n"
+   "--numa=<auto|off>           Interleave KDF memory across NUMA nodes (auto), or don't (off). A memory\n"
+   "                              policy set by e.g. numactl is always left in force.\n"
+   "--target-time=<seconds>     Choose the hardest KDF parameters that take this long on this machine.\n"
+   "                              Overrides -H, -L, -M, -I, -T and -B. Measurements are cached per host.\n"
+   "--max-memory=<mem[K|M|G]>   Limit the total KDF memory chosen by --target-time.\n"
+   "--profile                   Measure cycles, instructions, LLC and dTLB misses and page faults per phase\n"
+   "                              with perf_event_open(2), and report them with --stats (text by default).\n"
+   "                              The counter mode pass then runs on one thread, so that it's counted in full.\n"
+   "--progress                  Print the progress, throughput and estimated time remaining to stderr.\n"
+   "--show-resources            Print the memory and processors available to 4crypt, honoring cgroup\n"
+   "                              limits and CPU affinity, then exit.\n"
+   "--small-file-limit=<size>   Read and write input files up to this size (default 1M) whole with single\n"
+   "                              read and write calls instead of memory-mapping them. 0 always maps.\n"
+   "--stats=<text|json>         Print the time and throughput of each phase of the operation to stderr.\n"
+   "--trace=<filepath>          Record a timeline of phases and CTR tiles per thread, and write it to the\n"
+   "                              filepath as Chrome Trace Event JSON (for Perfetto) on exit.\n"
+   "--metrics=<filepath>        Add the byte, file, MAC failure and KDF counters and the phase latency\n"
+   "                              histograms of this run to the Prometheus textfile at filepath on exit.\n"
    "--pad-as-if=<size>          Pad the output ciphertext as if it were an unpadded encrypted file of this size.\n"
    "--pad-by=<size>             Pad the output ciphertext by this many bytes, rounded up such that the produced\n"
    "                              ciphertext is evenly divisible by 64.\n"
@@ -184,6 +182,25 @@ ArgProc::describe(const int argc, char** R_ argv, const int offset, void* R_ dat
    &input_argproc_processor);
 }
 
+int
+ArgProc::verify(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  PlainOldData* pod = static_cast<PlainOldData*>(data);
+  SSC_assertMsg(
+   pod->execute_mode == ExeMode::NONE,
+   "Execute mode already set to %s!\n", mode_strings[static_cast<int>(pod->execute_mode)]);
+  pod->execute_mode = ExeMode::VERIFY;
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   &input_argproc_processor);
+}
+
 int
 ArgProc::encrypt(const int argc, char** R_ argv, const int offset, void* R_ data)
 {
@@ -286,6 +303,65 @@ ArgProc::low_mem(const int argc, char** R_ argv, const int offset, void* R_ data
    });
 }
 
+int
+ArgProc::max_memory(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     PlainOldData* pod = static_cast<PlainOldData*>(dt);
+     pod->max_memory = parse_bytes(ap->to_read, ap->size);
+     SSC_assertMsg(pod->max_memory != 0, "Error: Invalid maximum memory '%s'!\n", ap->to_read);
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::metrics(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_) -> SSC_Error_t {
+     Metrics::start(std::string{ap->to_read, ap->size});
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::numa(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     PlainOldData* pod = static_cast<PlainOldData*>(dt);
+     if (strcmp(ap->to_read, "auto") == 0)
+       pod->flags &= ~Core::DISABLE_NUMA;
+     else if (strcmp(ap->to_read, "off") == 0)
+       pod->flags |= Core::DISABLE_NUMA;
+     else
+       SSC_errx("Invalid NUMA mode '%s'! Expected auto or off.\n", ap->to_read);
+     return SSC_OK;
+   });
+}
+
 int
 ArgProc::output(const int argc, char** R_ argv, const int offset, void* R_ data)
 {
@@ -327,7 +403,7 @@ ArgProc::pad_by(const int argc, char** R_ argv, const int offset, void* R_ data)
    nullptr,
    [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
      PlainOldData* pod = static_cast<PlainOldData*>(dt);
-     pod->padding_size = parse_padding(ap->to_read, ap->size);
+     pod->padding_size = parse_bytes(ap->to_read, ap->size);
      return SSC_OK;
    });
 }
@@ -340,6 +416,107 @@ ArgProc::pad_to(const int argc, char** R_ argv, const int offset, void* R_ data)
   return ArgProc::pad_by(argc, argv, offset, data);
 }
 
+int
+ArgProc::profile(const int, char** R_ argv, const int offset, void* R_ data)
+{
+  PlainOldData* pod = static_cast<PlainOldData*>(data);
+  pod->flags |= Core::PROFILE_COUNTERS;
+  return SSC_1opt(argv[0][offset]);
+}
+
+int
+ArgProc::progress(const int, char** R_ argv, const int offset, void* R_ data)
+{
+  PlainOldData* pod = static_cast<PlainOldData*>(data);
+  pod->flags |= Core::SHOW_PROGRESS;
+  return SSC_1opt(argv[0][offset]);
+}
+
+int
+ArgProc::show_resources(const int, char** R_, const int, void* R_)
+{
+  Resources::detect().print(stdout);
+  exit(EXIT_SUCCESS);
+  return 0; // Suppress compiler warnings.
+}
+
+int
+ArgProc::small_file_limit(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     PlainOldData* pod = static_cast<PlainOldData*>(dt);
+     pod->small_file_limit = parse_bytes(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::stats(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     PlainOldData* pod = static_cast<PlainOldData*>(dt);
+     if (strcmp(ap->to_read, "text") == 0)
+       pod->stats_format = ReportFormat::TEXT;
+     else if (strcmp(ap->to_read, "json") == 0)
+       pod->stats_format = ReportFormat::JSON;
+     else
+       SSC_errx("Invalid stats format '%s'! Expected text or json.\n", ap->to_read);
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::target_time(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     PlainOldData* pod = static_cast<PlainOldData*>(dt);
+     pod->target_seconds = std::strtod(ap->to_read, nullptr);
+     SSC_assertMsg(pod->target_seconds > 0.0, "Error: Invalid target time '%s'!\n", ap->to_read);
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::trace(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_) -> SSC_Error_t {
+     Trace::start(std::string{ap->to_read, ap->size});
+     return SSC_OK;
+   });
+}
+
 int
 ArgProc::threads(const int argc, char** R_ argv, const int offset, void* R_ data)
 {
@@ -386,6 +563,38 @@ ArgProc::use_phi(const int, char** R_ argv, const int offset, void* R_ data)
   return SSC_1opt(argv[0][offset]);
 }
 
+int
+ArgProc::affinity(const int argc, char** R_ argv, const int offset, void* R_ data)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_) -> SSC_Error_t {
+     Executor::Affinity affinity {};
+     if (strcmp(ap->to_read, "compact") == 0)
+       affinity = Executor::Affinity::COMPACT;
+     else if (strcmp(ap->to_read, "scatter") == 0)
+       affinity = Executor::Affinity::SCATTER;
+     else
+       SSC_errx("Invalid affinity '%s'! Expected compact or scatter.\n", ap->to_read);
+     Executor::configureGlobal(0, affinity);
+     return SSC_OK;
+   });
+}
+
+int
+ArgProc::agent(const int, char** R_ argv, const int offset, void* R_ data)
+{
+  PlainOldData* pod = static_cast<PlainOldData*>(data);
+  pod->flags |= Core::USE_AGENT;
+  return SSC_1opt(argv[0][offset]);
+}
+
 int
 ArgProc::batch_size(const int argc, char** R_ argv, const int offset, void* R_ data)
 {
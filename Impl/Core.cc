@@ -15,6 +15,16 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "Core.hh"
+#include "Agent.hh"
+#include "Calibration.hh"
+#include "Executor.hh"
+#include "MemoryBudget.hh"
+#include "Metrics.hh"
+#include "Numa.hh"
+#include "Probes.hh"
+#include "Resources.hh"
+#include "Stats.hh"
+#include "Trace.hh"
 #include "Util.hh"
 // SSC
 #include <SSC/Terminal.h>
@@ -24,11 +34,21 @@
 #include <TSC/Catena512.h>
 #include <TSC/Kdf.h>
 // C++ STL
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
 #include <limits>
 #include <thread>
 #include <memory>
 // C++ C Lib
+#include <cerrno>
 #include <cinttypes>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
 using namespace fourcrypt;
 
 #define R_ SSC_RESTRICT
@@ -75,6 +95,7 @@ Core::Core()
 /* Destroy the PlainOldData object and deallocate the memory. */
 Core::~Core()
 {
+  this->unmapFiles();
   PlainOldData::del(*this->getPod());
   delete this->getPod();
 }
@@ -110,6 +131,9 @@ consteval uint64_t Core::getMinimumOutputSize()
   return Core::getMetadataSize() + PAD_FACTOR;
 }
 static_assert(Core::PAD_FACTOR == 64);
+static_assert(Core::balanceBatchSize(9, 4) == 3);
+static_assert(Core::balanceBatchSize(10, 4) == 4);
+static_assert(Core::balanceBatchSize(8, 8) == 8);
 static_assert(Core::getMinimumOutputSize() % Core::PAD_FACTOR == 0);
 
 /* The initial state of most of the data in a PlainOldData consists of zero bytes, but there
@@ -141,8 +165,12 @@ void Core::PlainOldData::init(PlainOldData& pod)
   pod.padding_size  = 0;
   pod.thread_count  = 1;
   pod.thread_batch_size = 0;
+  pod.max_memory = 0;
+  pod.small_file_limit = SMALL_FILE_LIMIT_DEFAULT;
+  pod.target_seconds = 0.0;
   pod.execute_mode = ExeMode::NONE;
   pod.padding_mode = PadMode::ADD;
+  pod.stats_format = ReportFormat::NONE;
   pod.memory_low  = MEM_DEFAULT;
   pod.memory_high = MEM_DEFAULT;
   pod.iterations = 1;
@@ -158,12 +186,14 @@ void Core::PlainOldData::del(PlainOldData& pod)
 }
 
 /* Ensure that the thread batch size does not exceed the total specified thread count, as that
- * would be a contradiction.
+ * would be a contradiction. Then even out the batches; e.g. 9 threads in batches of 4 run
+ * as 4+4+1, whereas batches of 3 finish in the same 3 rounds with a quarter less memory.
  */
 void Core::PlainOldData::touchup(PlainOldData& pod)
 {
   if (pod.thread_batch_size == 0 || pod.thread_batch_size > pod.thread_count)
     pod.thread_batch_size = pod.thread_count;
+  pod.thread_batch_size = Core::balanceBatchSize(pod.thread_count, pod.thread_batch_size);
 }
 
 /* Tune for lesser memory usage, and therefore faster execution. */
@@ -180,36 +210,43 @@ void Core::PlainOldData::set_normal(PlainOldData& pod)
   pod.memory_high = MEM_NORMAL;
 }
 
-/* On systems that define SSC_HAS_GETAVAILABLESYSTEMMEMORY...
- *   Determine the amount of memory available for use TODO
- * On all other systems...
- *   TODO
+/* Enable Phi and choose the hardest KDF parameters that this host completes within
+ * Calibration::STRONG_TARGET_SECONDS, using at most half of the available memory.
+ * Memory per thread never drops below MEM_NORMAL.
  */
 void Core::PlainOldData::set_strong(PlainOldData& pod)
 {
-  #ifdef SSC_HAS_GETAVAILABLESYSTEMMEMORY
-  const uint64_t available {SSC_getAvailableSystemMemory()};
-  if (Core::memoryFromBitShift(MEM_STRONG) < available)
-   {
-    pod.memory_low  = MEM_STRONG;
-    pod.memory_high = MEM_STRONG;
-   }
-  else
-   {
-    PlainOldData::set_normal(pod);
-   }
-  uint64_t n_threads;
-  for (n_threads = 2; true; ++n_threads)
-   {
-    if ((Core::memoryFromBitShift(pod.memory_high) * n_threads) < available)
-      break;
-   }
-  pod.thread_count = n_threads;
-
-  #else
-  PlainOldData::set_normal(pod);
-  #endif
   pod.flags |= ENABLE_PHI;
+  Calibration::get().tune(pod, Calibration::STRONG_TARGET_SECONDS, Calibration::defaultMemoryBudget(), MEM_NORMAL);
+}
+
+/* Choose the hardest KDF parameters that this host completes within @target_seconds, using at
+ * most @max_memory bytes (or half of the available memory when @max_memory is 0).
+ */
+void Core::PlainOldData::set_calibrated(PlainOldData& pod)
+{
+  const uint64_t budget {(pod.max_memory != 0) ? pod.max_memory : Calibration::defaultMemoryBudget()};
+  Calibration::get().tune(pod, pod.target_seconds, budget);
+}
+
+uint64_t Core::planBatchSize(const PlainOldData& pod)
+{
+  uint64_t batch {pod.thread_batch_size};
+  if (batch == 0 || batch > pod.thread_count)
+    batch = pod.thread_count;
+  if (batch <= 1)
+    return 1;
+  const uint64_t available {Resources::detect().availableMemory()};
+  if (available != 0) {
+    const uint64_t margin   {std::max(available / PLAN_MARGIN_DIVISOR, PLAN_MARGIN_MIN)};
+    const uint64_t per_lane {Core::memoryFromBitShift(pod.memory_high)};
+    if (available <= margin)
+      return 1;
+    const uint64_t fits     {(available - margin) / per_lane};
+    if (fits < batch)
+      batch = (fits != 0) ? fits : 1;
+  }
+  return Core::balanceBatchSize(pod.thread_count, batch);
 }
 
 /* Return a raw pointer to a PlainOldData object. */
@@ -218,6 +255,258 @@ PlainOldData* Core::getPod()
   return this->pod;
 }
 
+/* Return a raw pointer to the KDF progress, which may be polled from other threads. */
+Core::KdfProgress* Core::getKdfProgress()
+{
+  return &this->kdf_progress;
+}
+
+double Core::KdfProgress::elapsedSeconds() const
+{
+  const int64_t started {this->started_ns.load(std::memory_order_acquire)};
+  if (started == 0)
+    return 0.0;
+  const int64_t now {std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()};
+  return static_cast<double>(now - started) / 1e9;
+}
+
+double Core::KdfProgress::estimatedFraction() const
+{
+  const uint64_t total {this->lanes_total.load(std::memory_order_acquire)};
+  if (total != 0 and this->lanes_done.load(std::memory_order_acquire) == total)
+    return 1.0;
+  const double predicted {this->predicted_seconds.load(std::memory_order_acquire)};
+  if (predicted <= 0.0)
+    return -1.0;
+  return std::min(this->elapsedSeconds() / predicted, 0.99);
+}
+
+/* Predict how long the KDF of @pod takes from this host's cached calibration, or return 0 if none is
+ * cached. Never measures one, which would take longer than many a KDF.
+ */
+static double
+predict_kdf_seconds(const PlainOldData& pod)
+{
+  static const Calibration cal {[]() -> Calibration {
+    Calibration c {};
+    const std::string path {Calibration::cachePath()};
+    if (path.empty() or not c.load(path))
+      c.seconds_per_byte = 0.0;
+    return c;
+  }()};
+  if (cal.seconds_per_byte <= 0.0)
+    return 0.0;
+  return cal.predict(pod.memory_high, pod.iterations, pod.thread_count, pod.thread_batch_size, static_cast<bool>(pod.flags & Core::ENABLE_PHI));
+}
+
+Core::AtomicProgress* Core::getProgress()
+{
+  return &this->progress;
+}
+
+Core::Progress Core::AtomicProgress::load() const
+{
+  Progress p;
+  uint64_t before, after;
+  do {
+    before = this->sequence.load(std::memory_order_acquire);
+    p.phase       = static_cast<Phase>(this->phase.load(std::memory_order_relaxed));
+    p.bytes_done  = this->bytes_done.load(std::memory_order_relaxed);
+    p.bytes_total = this->bytes_total.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = this->sequence.load(std::memory_order_relaxed);
+  } while ((before & 1) or before != after);
+  return p;
+}
+
+void Core::AtomicProgress::store(const Progress& p)
+{
+  const uint64_t seq {this->sequence.load(std::memory_order_relaxed)};
+  this->sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  this->phase.store(static_cast<int>(p.phase), std::memory_order_relaxed);
+  this->bytes_done.store(p.bytes_done, std::memory_order_relaxed);
+  this->bytes_total.store(p.bytes_total, std::memory_order_relaxed);
+  this->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void Core::setStats(Stats* s)
+{
+  this->stats = s;
+}
+
+void Core::setKdfGate(std::binary_semaphore* gate)
+{
+  this->kdf_gate = gate;
+}
+
+void Core::setExecutor(Executor* ex)
+{
+  this->executor = ex;
+}
+
+void Core::setMemoryBudget(MemoryBudget* budget)
+{
+  this->memory_budget = budget;
+}
+
+Core::CancelToken* Core::getCancelToken()
+{
+  return this->cancel_token;
+}
+
+void Core::setCancelToken(CancelToken* token)
+{
+  this->cancel_token = (token != nullptr) ? token : &this->own_cancel_token;
+}
+
+bool Core::isCancelled() const
+{
+  return this->cancel_token->isCancelled();
+}
+
+void Core::wipeKeys()
+{
+  PlainOldData* mypod {this->getPod()};
+  SSC_secureZero(&mypod->tf_ctr, sizeof(mypod->tf_ctr));
+  SSC_secureZero(mypod->tf_sec_key, sizeof(mypod->tf_sec_key));
+  SSC_secureZero(mypod->mac_key, sizeof(mypod->mac_key));
+  SSC_secureZero(mypod->hash_buffer, sizeof(mypod->hash_buffer));
+}
+
+SSC_CodeError_t Core::abandon()
+{
+  PlainOldData* mypod {this->getPod()};
+  const bool    had_output {mypod->output_map.ptr != nullptr};
+  this->wipeKeys();
+  this->unmapFiles();
+  if (had_output)
+    remove(mypod->output_filename);
+  return ERROR_CANCELLED;
+}
+
+/* genRandomElements() destroys the CSPRNG after drawing from it, so every operation needs a freshly seeded one. */
+void Core::reset()
+{
+  PlainOldData* mypod {this->getPod()};
+  // A reused Core must not keep the maps of a failed operation alive.
+  this->unmapFiles();
+  PlainOldData::del(*mypod);
+  PlainOldData::init(*mypod);
+  TSC_CSPRNG_init(&mypod->rng);
+  this->kdf_progress.lanes_total.store(0, std::memory_order_relaxed);
+  this->kdf_progress.lanes_done.store(0, std::memory_order_relaxed);
+  this->kdf_progress.started_ns.store(0, std::memory_order_relaxed);
+  this->kdf_progress.predicted_seconds.store(0.0, std::memory_order_relaxed);
+  this->startProgress(0);
+}
+
+const char* Core::phaseName(Phase phase)
+{
+  static const char* names[] = {
+    "map_files", "password", "random", "kdf", "header", "cipher", "mac", "sync", "unmap_files"
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == static_cast<size_t>(Phase::COUNT));
+  return names[static_cast<int>(phase)];
+}
+
+void Core::beginPhase(Phase phase)
+{
+  this->progress_phase = phase;
+  this->progress.store({phase, this->progress_done, this->progress_total});
+  Trace::begin(Core::phaseName(phase), "phase");
+  if (this->stats != nullptr)
+    this->stats->begin(phase);
+  if (Metrics::enabled())
+    this->phase_started[static_cast<int>(phase)] = std::chrono::steady_clock::now();
+}
+
+void Core::endPhase(Phase phase, uint64_t bytes)
+{
+  if (this->stats != nullptr)
+    this->stats->end(phase, bytes);
+  Trace::end(Core::phaseName(phase), "phase", bytes);
+  auto& started {this->phase_started[static_cast<int>(phase)]};
+  // Phases begun before Metrics::start() have no start time.
+  if (Metrics::enabled() and started != std::chrono::steady_clock::time_point{}) {
+    Metrics::observePhase(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+    started = {};
+  }
+}
+
+void Core::startProgress(uint64_t bytes_total)
+{
+  this->progress_phase = Phase::COUNT;
+  this->progress_done  = 0;
+  this->progress_total = bytes_total;
+  this->progress.store({this->progress_phase, 0, bytes_total});
+}
+
+void Core::advanceProgress(uint64_t bytes)
+{
+  this->progress_done += bytes;
+  this->progress.store({this->progress_phase, this->progress_done, this->progress_total});
+}
+
+#if defined(SSC_OS_UNIXLIKE)
+/* Open the regular file at @path and return its descriptor if it is no larger than @limit bytes,
+ * storing its size at @size. Otherwise return -1, and leave the file to the memory-mapped path,
+ * which also reports any errors.
+ */
+static int
+open_small_file(const char* path, uint64_t limit, size_t* size)
+{
+  if (limit == 0)
+    return -1;
+  const int fd {open(path, O_RDONLY | O_CLOEXEC)};
+  if (fd == -1)
+    return -1;
+  struct stat st;
+  if (fstat(fd, &st) != 0 or not S_ISREG(st.st_mode) or static_cast<uint64_t>(st.st_size) > limit) {
+    close(fd);
+    return -1;
+  }
+  *size = static_cast<size_t>(st.st_size);
+  return fd;
+}
+
+/* Read exactly @num bytes from @fd to @to. A regular file that reads short changed size under us. */
+static bool
+read_whole(int fd, uint8_t* to, uint64_t num)
+{
+  while (num != 0) {
+    const ssize_t n {read(fd, to, num)};
+    if (n == -1 and errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    to  += n;
+    num -= static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+/* Write all @num bytes at @from to @fd, then flush them to the disk. */
+static bool
+write_whole(int fd, const uint8_t* from, uint64_t num)
+{
+  while (num != 0) {
+    const ssize_t n {write(fd, from, num)};
+    if (n == -1 and errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    from += n;
+    num  -= static_cast<uint64_t>(n);
+  }
+ #if defined(__APPLE__)
+  return fsync(fd) == 0;
+ #else
+  return fdatasync(fd) == 0;
+ #endif
+}
+#endif
+
 SSC_CodeError_t Core::encrypt(
  ErrType*          err_typ,
  InOutDir*         err_dir,
@@ -225,6 +514,10 @@ SSC_CodeError_t Core::encrypt(
  void*             status_callback_data)
 {
   PlainOldData* mypod {this->getPod()};
+  // Failures that aren't tied to one of the files, e.g. of the KDF or a cancellation, leave these be.
+  *err_typ = ErrType::CORE;
+  *err_dir = InOutDir::NONE;
+  this->startProgress(0);
   // We require input and output filenames defined for ENCRYPT mode.
   if (mypod->input_filename == nullptr)
     return ERROR_NO_INPUT_FILENAME;
@@ -244,101 +537,164 @@ SSC_CodeError_t Core::encrypt(
 
   // Get the size of the input file.
   size_t input_filesize;
+ #if defined(SSC_OS_UNIXLIKE)
+  if (const int fd {open_small_file(mypod->input_filename, mypod->small_file_limit, &input_filesize)}; fd != -1)
+    return this->encryptSmallFile(fd, input_filesize, err_typ, err_dir, status_callback, status_callback_data);
+ #endif
   if (SSC_FilePath_getSize(mypod->input_filename, &input_filesize))
     return ERROR_GETTING_INPUT_FILESIZE;
 
   // Normalize the padding.
-  this->normalizePadding(input_filesize);
+  if (this->normalizePadding(input_filesize) != SSC_OK)
+    return ERROR_INVALID_PADDING;
   InOutDir err_io_dir {InOutDir::NONE};
 
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Map the input and output files.
+  const uint64_t output_filesize {input_filesize + mypod->padding_size + Core::getMetadataSize()};
+  // The counter mode pass covers the padding and plaintext; the MAC pass covers everything but the MAC.
+  this->startProgress((mypod->padding_size + input_filesize) + (output_filesize - MAC_SIZE));
+  this->beginPhase(Phase::MAP_FILES);
   SSC_CodeError_t err {
    this->mapFiles(
     &err_io_dir,
     input_filesize,
-    input_filesize + mypod->padding_size + Core::getMetadataSize(),
+    output_filesize,
     InOutDir::NONE)};
+  this->endPhase(Phase::MAP_FILES, input_filesize + output_filesize);
   if (err) {
+    // The input may have been mapped before the output failed.
+    this->unmapFiles();
     *err_typ = ErrType::MEMMAP;
     *err_dir = err_io_dir;
     return err;
   }
+  this->prefetchInput(true);
 
   // If the password has not already been initialized, then initialize it.
   if (mypod->password_size == 0) {
+    this->beginPhase(Phase::PASSWORD);
     // Get the encryption password.
     this->getPassword(not (mypod->flags & Core::ENTER_PASS_ONCE), false);
     if (mypod->flags & Core::SUPPLEMENT_ENTROPY) {
       // Get the entropy password and hash it into the RNG.
       this->getPassword(false, true);
     }
+    this->endPhase(Phase::PASSWORD);
   }
+  if (this->isCancelled())
+    return this->abandon();
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Generate pseudorandom values.
+  this->beginPhase(Phase::RANDOM);
   this->genRandomElements();
+  this->endPhase(Phase::RANDOM, TSC_THREEFISH512_TWEAK_BYTES + sizeof(mypod->catena_salt) + sizeof(mypod->tf_ctr_iv));
   // Run the key derivation function and get our secret values.
   if (status_callback != nullptr)
     status_callback(status_callback_data);
-  this->runKDF();
+  this->beginPhase(Phase::KDF);
+  err = this->runKDF();
+  this->endPhase(Phase::KDF);
+  if (err) {
+    // Don't leave a truncated output file behind.
+    this->unmapFiles();
+    remove(mypod->output_filename);
+    return err;
+  }
   const uint8_t* in   {mypod->input_map.ptr};
   uint8_t*       out  {mypod->output_map.ptr};
   size_t         n_in {mypod->input_map.size};
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Write the header of the ciphertext file.
-  out = this->writeHeader(out);
+  this->beginPhase(Phase::HEADER);
+  out = this->writeHeader(out, output_filesize);
+  this->endPhase(Phase::HEADER, Core::getHeaderSize());
   // Encrypt the input stream into the ciphertext file.
+  this->beginPhase(Phase::CIPHER);
   out = this->writeCiphertext(out, in, n_in);
+  this->endPhase(Phase::CIPHER, mypod->padding_size + n_in);
+  if (out == nullptr or this->isCancelled())
+    return this->abandon();
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Write the Message Authentication Code to the end of the file.
+  this->beginPhase(Phase::MAC);
   this->writeMAC(out, mypod->output_map.ptr, mypod->output_map.size - MAC_SIZE);
+  this->advanceProgress(mypod->output_map.size - MAC_SIZE);
+  this->endPhase(Phase::MAC, mypod->output_map.size - MAC_SIZE);
+  if (this->isCancelled())
+    return this->abandon();
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Synchronize the SSC_MemMap's.
+  this->beginPhase(Phase::SYNC);
   this->syncMaps();
+  this->endPhase(Phase::SYNC, mypod->input_map.size + mypod->output_map.size);
   // Unmap the input and output SSC_MemMap's.
+  this->beginPhase(Phase::UNMAP_FILES);
   this->unmapFiles();
+  this->endPhase(Phase::UNMAP_FILES);
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Success.
+  Metrics::add(Metrics::Counter::BYTES_ENCRYPTED, input_filesize);
+  Metrics::add(Metrics::Counter::FILES_ENCRYPTED);
   return 0;
 }
 
 SSC_Error_t Core::normalizePadding(const uint64_t input_filesize)
 {
   PlainOldData* mypod = this->getPod();
-  const uint64_t size = input_filesize;
-  uint64_t pad  = mypod->padding_size;
-  switch (mypod->padding_mode) {
+  return Core::computePadding(input_filesize, &mypod->padding_size, &mypod->padding_mode);
+}
+
+SSC_Error_t Core::computePadding(const uint64_t input_size, uint64_t* R_ padding_size, PadMode* R_ padding_mode)
+{
+  const uint64_t size = input_size;
+  uint64_t pad  = *padding_size;
+  switch (*padding_mode) {
     // Add @pad to @size, then round up to be evenly divisible by PAD_FACTOR.
     case PadMode::ADD:
       if ((size + pad) % PAD_FACTOR)
-        mypod->padding_size = pad + (PAD_FACTOR - ((size + pad) % PAD_FACTOR));
+        *padding_size = pad + (PAD_FACTOR - ((size + pad) % PAD_FACTOR));
       break;
     // Goal: Output file is an exact, specific size specified in @pad.
     case PadMode::TARGET:
       if (pad < (size + Core::getMetadataSize()))
         return SSC_ERR;
-      mypod->padding_size = pad - (size + Core::getMetadataSize());
-      mypod->padding_mode = PadMode::ADD;
-      return this->normalizePadding(size);
+      *padding_size = pad - (size + Core::getMetadataSize());
+      *padding_mode = PadMode::ADD;
+      return Core::computePadding(size, padding_size, padding_mode);
     // Add padding as if @size were @pad.
     case PadMode::AS_IF:
       if (pad < size)
         return SSC_ERR;
-      mypod->padding_size = pad - size;
-      mypod->padding_mode = PadMode::ADD;
-      return this->normalizePadding(size);
+      *padding_size = pad - size;
+      *padding_mode = PadMode::ADD;
+      return Core::computePadding(size, padding_size, padding_mode);
     default:
       return SSC_ERR;
   }
   return SSC_OK;
 }
 
+uint64_t Core::getEncryptedSize(uint64_t plaintext_size, uint64_t padding_size, PadMode padding_mode)
+{
+  if (Core::computePadding(plaintext_size, &padding_size, &padding_mode) != SSC_OK)
+    return 0;
+  return plaintext_size + padding_size + Core::getMetadataSize();
+}
+
+uint64_t Core::getDecryptedSizeBound(uint64_t ciphertext_size)
+{
+  if (ciphertext_size < Core::getMinimumOutputSize())
+    return 0;
+  return ciphertext_size - Core::getMetadataSize();
+}
+
 void Core::genRandomElements()
 {
   PlainOldData* mypod = this->getPod();
@@ -363,37 +719,211 @@ void Core::genRandomElements()
   SSC_secureZero(myrng, sizeof(*myrng));
 }
 
+/* The inputs and outputs of one key derivation, shared between runKDF() and the thread computing it,
+ * so that a cancelled runKDF() can return while TSC_kdf runs to completion in the background.
+ * The copies of the secrets are wiped by whichever side lets go last.
+ */
+struct KdfCall
+ {
+  alignas(uint64_t) uint8_t salt     [TSC_CATENA512_SALT_BYTES];
+  uint8_t                   password [Core::PW_BUFFER_BYTES];
+  uint8_t                   output   [TSC_KDF_OUTPUT_BYTES];
+  uint64_t                  password_size;
+  uint64_t                  thread_count;
+  uint64_t                  batch_size;
+  uint8_t                   memory_low;
+  uint8_t                   memory_high;
+  uint8_t                   iterations;
+  bool                      phi;
+  MemoryBudget*             budget   {nullptr}; // Return @reserved bytes to @budget when done.
+  uint64_t                  reserved {0};
+  std::binary_semaphore*    gate     {nullptr}; // Release @gate when done.
+  SSC_Error_t               result {SSC_OK};
+  bool                      done   {false};
+  std::mutex                mtx    {};
+  std::condition_variable   cv     {};
+
+  ~KdfCall()
+   {
+    SSC_secureZero(this->password, sizeof(this->password));
+    SSC_secureZero(this->output, sizeof(this->output));
+   }
+ };
+
+static void
+compute_kdf(std::shared_ptr<KdfCall> call)
+{
+  for (;;) {
+    call->result = TSC_kdf(
+     call->output,
+     call->salt,
+     call->password,
+     call->password_size,
+     call->thread_count,
+     call->batch_size,
+     call->memory_low,
+     call->memory_high,
+     call->iterations,
+     call->phi);
+    if (call->result != SSC_ERR || call->batch_size <= 1)
+      break;
+    // The available memory may have shrunk since planning; retry with half as many threads at once.
+    call->batch_size = Core::balanceBatchSize(call->thread_count, call->batch_size / 2);
+  }
+  SSC_secureZero(call->password, sizeof(call->password));
+  if (call->budget != nullptr)
+    call->budget->release(call->reserved);
+  // Only now, so that a KDF abandoned on cancellation still counts against the gate until it's over.
+  if (call->gate != nullptr)
+    call->gate->release();
+  {
+    std::lock_guard<std::mutex> lock {call->mtx};
+    call->done = true;
+  }
+  call->cv.notify_all();
+}
+
 /* Run the key derivation function, kdf(), utilizing as many threads
  * as were specified by the user. This necessitates a lot of dynamic
  * allocation.
+ *
+ * The Catena512 lanes are computed inside TSC_kdf, which defines the per-lane salts, the graph
+ * traversal and how lane outputs are combined; every existing 4crypt file depends on them.
+ *
+ * TSC_kdf can't be interrupted either, so it runs on a thread of its own while this thread waits
+ * for it or for a cancellation. A cancelled KDF is abandoned: it finishes in the background,
+ * holding its memory, its budget reservation and the KDF gate until then, and its result is discarded.
  */
-SSC_Error_t Core::runKDF()
+SSC_CodeError_t Core::runKDF()
 {
   static_assert(TSC_KDF_OUTPUT_BYTES == TSC_THREEFISH512_BLOCK_BYTES);
   PlainOldData*  mypod         {this->getPod()};
+  KdfProgress*   progress      {this->getKdfProgress()};
   uint8_t        kdf_out[TSC_KDF_OUTPUT_BYTES] {0};
-  SSC_Error_t result {TSC_kdf(
-    kdf_out,
-    mypod->catena_salt,
-    mypod->password_buffer,
-    mypod->password_size,
-    mypod->thread_count,
-    mypod->thread_batch_size,
-    mypod->memory_low,
-    mypod->memory_high,
-    mypod->iterations,
-    static_cast<bool>(mypod->flags & Core::ENABLE_PHI)
-  )};
+  progress->lanes_total.store(mypod->thread_count, std::memory_order_relaxed);
+  progress->lanes_done.store(0, std::memory_order_relaxed);
+  progress->started_ns.store(0, std::memory_order_relaxed);
+  progress->predicted_seconds.store(0.0, std::memory_order_relaxed);
+  // This is the last opportunity to abort before potentially gigabytes of memory get allocated.
+  if (this->isCancelled())
+    return ERROR_CANCELLED;
+  const bool use_agent {static_cast<bool>(mypod->flags & Core::USE_AGENT)};
+  if (use_agent and Agent::lookup(*mypod, kdf_out)) {
+    Metrics::add(Metrics::Counter::KDF_CACHE_HITS);
+    progress->lanes_done.store(mypod->thread_count, std::memory_order_release);
+    this->expandKdfOutput(kdf_out);
+    return ERROR_NONE;
+  }
+  if (this->kdf_gate != nullptr) {
+    // Another job's KDF may take minutes; wait in slices short enough to notice a cancellation.
+    while (not this->kdf_gate->try_acquire_for(std::chrono::milliseconds(CANCEL_POLL_MILLISECONDS))) {
+      if (this->isCancelled())
+        return ERROR_CANCELLED;
+    }
+    if (this->isCancelled()) {
+      this->kdf_gate->release();
+      return ERROR_CANCELLED;
+    }
+  }
+  progress->running.store(true, std::memory_order_release);
+  // Don't ask for more memory at once than is available.
+  mypod->thread_batch_size = Core::planBatchSize(*mypod);
+  uint64_t reserved {0};
+  if (this->memory_budget != nullptr) {
+    // Nor more than the whole budget; then wait until that much of it is free.
+    const uint64_t per_thread {Core::memoryFromBitShift(mypod->memory_high)};
+    const uint64_t fit        {std::max<uint64_t>(this->memory_budget->capacity() / per_thread, 1)};
+    if (mypod->thread_batch_size > fit)
+      mypod->thread_batch_size = Core::balanceBatchSize(mypod->thread_count, fit);
+    reserved = per_thread * mypod->thread_batch_size;
+    if (not this->memory_budget->acquire(reserved, this->cancel_token)) {
+      progress->running.store(false, std::memory_order_release);
+      if (this->kdf_gate != nullptr)
+        this->kdf_gate->release();
+      return ERROR_CANCELLED;
+    }
+  }
+  FOURCRYPT_PROBE6(
+   kdf_entry,
+   mypod->memory_low,
+   mypod->memory_high,
+   mypod->iterations,
+   mypod->thread_count,
+   mypod->thread_batch_size,
+   static_cast<int>(static_cast<bool>(mypod->flags & Core::ENABLE_PHI)));
+  auto call {std::make_shared<KdfCall>()};
+  memcpy(call->salt, mypod->catena_salt, sizeof(call->salt));
+  memcpy(call->password, mypod->password_buffer, sizeof(call->password));
+  call->password_size = mypod->password_size;
+  call->thread_count  = mypod->thread_count;
+  call->batch_size    = mypod->thread_batch_size;
+  call->memory_low    = mypod->memory_low;
+  call->memory_high   = mypod->memory_high;
+  call->iterations    = mypod->iterations;
+  call->phi           = static_cast<bool>(mypod->flags & Core::ENABLE_PHI);
+  call->budget        = this->memory_budget;
+  call->reserved      = reserved;
+  call->gate          = this->kdf_gate;
+  /* The KDF threads are memory-bandwidth bound and first-touch their memory wherever the
+   * scheduler happens to place them. On multi-node hosts spread the memory over every node's
+   * memory controller instead, unless the process was started with a policy of its own.
+   * The threads spawned from here on inherit this thread's policy.
+   */
+  NumaPolicy policy      {};
+  const bool interleaved {not (mypod->flags & Core::DISABLE_NUMA) and numa_interleave_begin(&policy)};
+  const auto started     {std::chrono::steady_clock::now()};
+  // Waiting for the gate or the budget doesn't count towards the prediction.
+  progress->predicted_seconds.store(predict_kdf_seconds(*mypod), std::memory_order_relaxed);
+  progress->started_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(started.time_since_epoch()).count(), std::memory_order_release);
+  std::thread kdf_thread {&compute_kdf, call};
+  if (interleaved)
+    numa_interleave_end(policy);
+  bool cancelled {false};
+  {
+    std::unique_lock<std::mutex> lock {call->mtx};
+    while (not call->done) {
+      if (this->isCancelled()) {
+        cancelled = true;
+        break;
+      }
+      call->cv.wait_for(lock, std::chrono::milliseconds(CANCEL_POLL_MILLISECONDS));
+    }
+  }
+  progress->running.store(false, std::memory_order_release);
+  if (cancelled) {
+    kdf_thread.detach();
+    FOURCRYPT_PROBE2(kdf_return, ERROR_CANCELLED, mypod->thread_batch_size);
+    return ERROR_CANCELLED;
+  }
+  // The thread has nothing left to do. Joining it also folds the performance counts it inherited
+  // into this thread's before the KDF phase ends, as they're only passed up when it exits.
+  kdf_thread.join();
+  const SSC_Error_t result {call->result};
+  mypod->thread_batch_size = call->batch_size;
+  memcpy(kdf_out, call->output, sizeof(kdf_out));
+  FOURCRYPT_PROBE2(kdf_return, result == SSC_ERR ? ERROR_KDF_FAILED : ERROR_NONE, mypod->thread_batch_size);
   if (result == SSC_ERR)
-    return SSC_ERR;
+    return ERROR_KDF_FAILED;
+  Metrics::add(Metrics::Counter::KDF_INVOCATIONS);
+  Metrics::observeKdf(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+  progress->lanes_done.store(mypod->thread_count, std::memory_order_release);
+  if (use_agent)
+    Agent::store(*mypod, kdf_out);
+  this->expandKdfOutput(kdf_out);
+  return ERROR_NONE;
+}
+
+void Core::expandKdfOutput(uint8_t* R_ kdf_out)
+{
+  PlainOldData* mypod {this->getPod()};
   // Hash into 128 bytes of output.
   TSC_Skein512_hash(
    mypod->skein512,
    mypod->hash_buffer,
    sizeof(mypod->hash_buffer),
    kdf_out,
-   sizeof(kdf_out));
-  SSC_secureZero(kdf_out, sizeof(kdf_out));
+   TSC_KDF_OUTPUT_BYTES);
+  SSC_secureZero(kdf_out, TSC_KDF_OUTPUT_BYTES);
   // The first 64 become the secret encryption key; the latter 64 become the authentication key.
   memcpy(mypod->tf_sec_key, mypod->hash_buffer, TSC_THREEFISH512_BLOCK_BYTES);
   memcpy(mypod->mac_key   , mypod->hash_buffer + TSC_THREEFISH512_BLOCK_BYTES, TSC_THREEFISH512_BLOCK_BYTES);
@@ -404,8 +934,6 @@ SSC_Error_t Core::runKDF()
    mypod->tf_sec_key,
    mypod->tf_tweak,
    mypod->tf_ctr_iv);
-
-  return SSC_OK;
 }
 
 /* Verify that the @size bytes starting at @begin produce the same Message Authentication
@@ -415,6 +943,7 @@ SSC_Error_t Core::verifyMAC(const uint8_t* R_ mac, const uint8_t* R_ begin, cons
 {
   alignas(uint64_t) uint8_t tmp_mac [MAC_SIZE];
   PlainOldData* mypod {this->getPod()};
+  FOURCRYPT_PROBE1(mac_verify_entry, size);
   TSC_Skein512_mac(
    mypod->skein512,
    tmp_mac,
@@ -422,8 +951,12 @@ SSC_Error_t Core::verifyMAC(const uint8_t* R_ mac, const uint8_t* R_ begin, cons
    begin,
    size,
    mypod->mac_key);
-  if (SSC_constTimeMemDiff(tmp_mac, mac, MAC_SIZE))
+  const bool matched {not SSC_constTimeMemDiff(tmp_mac, mac, MAC_SIZE)};
+  FOURCRYPT_PROBE2(mac_verify_return, size, static_cast<int>(matched));
+  if (not matched) {
+    Metrics::add(Metrics::Counter::MAC_FAILURES);
     return SSC_ERR;
+  }
   return SSC_OK;
 }
 
@@ -434,6 +967,9 @@ SSC_CodeError_t Core::decrypt(
  void*             status_callback_data)
 {
   PlainOldData* mypod {this->getPod()};
+  *err_type   = ErrType::CORE;
+  *err_io_dir = InOutDir::NONE;
+  this->startProgress(0);
   // Ensure at least an input file path is provided.
   if (mypod->input_filename == nullptr) {
     *err_io_dir = InOutDir::INPUT;
@@ -454,6 +990,10 @@ SSC_CodeError_t Core::decrypt(
   }
   // Get the size of the input file.
   size_t input_filesize;
+ #if defined(SSC_OS_UNIXLIKE)
+  if (const int fd {open_small_file(mypod->input_filename, mypod->small_file_limit, &input_filesize)}; fd != -1)
+    return this->decryptSmallFile(fd, input_filesize, err_type, err_io_dir, status_callback, status_callback_data);
+ #endif
   if (SSC_FilePath_getSize(mypod->input_filename, &input_filesize)) {
     *err_io_dir = InOutDir::INPUT;
     return ERROR_GETTING_INPUT_FILESIZE;
@@ -472,6 +1012,10 @@ SSC_CodeError_t Core::decrypt(
   {
     if (status_callback != nullptr)
       status_callback(status_callback_data);
+    // The MAC pass covers everything but the MAC; the counter mode pass covers the ciphertext.
+    // Until the header is deciphered, assume there is no padding.
+    this->startProgress((input_filesize - MAC_SIZE) + (input_filesize - Core::getMetadataSize()));
+    this->beginPhase(Phase::MAP_FILES);
     SSC_CodeError_t err {
      this->mapFiles(
       nullptr,
@@ -479,52 +1023,84 @@ SSC_CodeError_t Core::decrypt(
       0,
       InOutDir::INPUT)
     };
+    this->endPhase(Phase::MAP_FILES, input_filesize);
     if (err != ERROR_NONE) {
       *err_io_dir = InOutDir::INPUT;
       return ERROR_INPUT_MEMMAP_FAILED;
     }
   }
   if (!Core::verifyBasicMetadata(mypod, InOutDir::INPUT)) {
+    this->unmapFiles();
     *err_io_dir = InOutDir::INPUT;
     return ERROR_INVALID_4CRYPT_FILE;
   }
+  this->prefetchInput(false);
   // If the decryption password has not already been initialized, then initialize it.
-  if (mypod->password_size == 0)
+  if (mypod->password_size == 0) {
+    this->beginPhase(Phase::PASSWORD);
     this->getPassword(false, false);
+    this->endPhase(Phase::PASSWORD);
+  }
   const uint8_t* in     {mypod->input_map.ptr};
   const size_t   num_in {mypod->input_map.size};
   SSC_CodeError_t err   {0};
   // Read the input file header's plaintext.
-  in = this->readHeaderPlaintext(in, &err);
-  if (err)
+  this->beginPhase(Phase::HEADER);
+  in = this->readHeaderPlaintext(in, num_in, &err);
+  this->endPhase(Phase::HEADER);
+  if (err) {
+    this->unmapFiles();
     return err;
+  }
   PlainOldData::touchup(*mypod);
   // Run the KDF to generate secret values.
   if (status_callback != nullptr)
     status_callback(status_callback_data);
-  this->runKDF();
+  this->beginPhase(Phase::KDF);
+  err = this->runKDF();
+  this->endPhase(Phase::KDF);
+  if (err) {
+    this->unmapFiles();
+    return err;
+  }
   // Check the MAC for integrity and authentication.
   if (status_callback != nullptr)
     status_callback(status_callback_data);
+  this->beginPhase(Phase::MAC);
   err = this->verifyMAC(
    mypod->input_map.ptr + (num_in - MAC_SIZE),
    mypod->input_map.ptr,
    num_in - MAC_SIZE);
+  this->advanceProgress(num_in - MAC_SIZE);
+  this->endPhase(Phase::MAC, num_in - MAC_SIZE);
   if (err) {
+    this->wipeKeys();
+    this->unmapFiles();
     *err_io_dir = InOutDir::INPUT;
     return ERROR_MAC_VALIDATION_FAILED;
   }
+  if (this->isCancelled())
+    return this->abandon();
   // Decipher the encrypted portion of the input file header.
   if (status_callback != nullptr)
     status_callback(status_callback_data);
+  this->beginPhase(Phase::HEADER);
   in = this->readHeaderCiphertext(in, &err);
-  if (err)
+  this->endPhase(Phase::HEADER, Core::getHeaderSize());
+  if (err) {
+    this->wipeKeys();
+    this->unmapFiles();
     return err;
+  }
+  // The padding is skipped rather than deciphered.
+  this->progress_total -= mypod->padding_size;
+  this->advanceProgress(0);
   // Map the output file
   const size_t num_out {num_in - Core::getMetadataSize() - mypod->padding_size};
   {
     if (status_callback != nullptr)
       status_callback(status_callback_data);
+    this->beginPhase(Phase::MAP_FILES);
     SSC_CodeError_t err {
      this->mapFiles(
       nullptr,
@@ -532,7 +1108,10 @@ SSC_CodeError_t Core::decrypt(
       num_out,
       InOutDir::OUTPUT)
     };
+    this->endPhase(Phase::MAP_FILES, num_out);
     if (err != ERROR_NONE) {
+      this->wipeKeys();
+      this->unmapFiles();
       *err_io_dir = InOutDir::OUTPUT;
       return ERROR_OUTPUT_MEMMAP_FAILED;
     }
@@ -540,41 +1119,453 @@ SSC_CodeError_t Core::decrypt(
   // Decipher the encrypted payload into the mapped output file.
   if (status_callback != nullptr)
     status_callback(status_callback_data);
-  this->writePlaintext(mypod->output_map.ptr, in, num_out);
-  
+  this->beginPhase(Phase::CIPHER);
+  err = this->writePlaintext(mypod->output_map.ptr, in, num_out);
+  this->endPhase(Phase::CIPHER, num_out);
+  // Don't leave partial plaintext behind.
+  if (err or this->isCancelled())
+    return this->abandon();
+
   if (status_callback != nullptr)
     status_callback(status_callback_data);
   // Synchronize and unmap the SSC_MemMap's. Success.
+  this->beginPhase(Phase::SYNC);
   this->syncMaps();
+  this->endPhase(Phase::SYNC, mypod->input_map.size + mypod->output_map.size);
+  this->beginPhase(Phase::UNMAP_FILES);
   this->unmapFiles();
+  this->endPhase(Phase::UNMAP_FILES);
+  Metrics::add(Metrics::Counter::BYTES_DECRYPTED, num_out);
+  Metrics::add(Metrics::Counter::FILES_DECRYPTED);
   return SSC_OK;
 }
 
-SSC_Error_t Core::syncMaps()
+/* The first steps of decrypt(): everything up to and including the MAC, with no output file. */
+SSC_CodeError_t Core::verify(
+ ErrType*          err_type,
+ InOutDir*         err_io_dir,
+ StatusCallback_f* status_callback,
+ void*             status_callback_data)
 {
   PlainOldData* mypod {this->getPod()};
-  if (mypod->input_map.ptr) {
-    if (SSC_MemMap_sync(&mypod->input_map))
-      return SSC_ERR;
+  *err_type   = ErrType::CORE;
+  *err_io_dir = InOutDir::NONE;
+  this->startProgress(0);
+  if (mypod->input_filename == nullptr) {
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_NO_INPUT_FILENAME;
   }
-  if (mypod->output_map.ptr) {
-    if (SSC_MemMap_sync(&mypod->output_map))
-      return SSC_ERR;
+  size_t input_filesize;
+  if (SSC_FilePath_getSize(mypod->input_filename, &input_filesize)) {
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_GETTING_INPUT_FILESIZE;
   }
-  return SSC_OK;
+  if (input_filesize < Core::getMinimumOutputSize()) {
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_INPUT_FILESIZE_TOO_SMALL;
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->startProgress(input_filesize - MAC_SIZE);
+  this->beginPhase(Phase::MAP_FILES);
+  SSC_CodeError_t err {this->mapFiles(nullptr, input_filesize, 0, InOutDir::INPUT)};
+  this->endPhase(Phase::MAP_FILES, input_filesize);
+  if (err != ERROR_NONE) {
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_INPUT_MEMMAP_FAILED;
+  }
+  if (!Core::verifyBasicMetadata(mypod, InOutDir::INPUT)) {
+    this->unmapFiles();
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_INVALID_4CRYPT_FILE;
+  }
+  if (mypod->password_size == 0) {
+    this->beginPhase(Phase::PASSWORD);
+    this->getPassword(false, false);
+    this->endPhase(Phase::PASSWORD);
+  }
+  const size_t num_in {mypod->input_map.size};
+  this->beginPhase(Phase::HEADER);
+  this->readHeaderPlaintext(mypod->input_map.ptr, num_in, &err);
+  this->endPhase(Phase::HEADER);
+  if (err) {
+    this->unmapFiles();
+    return err;
+  }
+  PlainOldData::touchup(*mypod);
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::KDF);
+  err = this->runKDF();
+  this->endPhase(Phase::KDF);
+  if (err) {
+    this->unmapFiles();
+    return err;
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::MAC);
+  const SSC_Error_t mac_err {
+   this->verifyMAC(
+    mypod->input_map.ptr + (num_in - MAC_SIZE),
+    mypod->input_map.ptr,
+    num_in - MAC_SIZE)
+  };
+  this->advanceProgress(num_in - MAC_SIZE);
+  this->endPhase(Phase::MAC, num_in - MAC_SIZE);
+  this->wipeKeys();
+  this->beginPhase(Phase::UNMAP_FILES);
+  this->unmapFiles();
+  this->endPhase(Phase::UNMAP_FILES);
+  if (mac_err) {
+    *err_io_dir = InOutDir::INPUT;
+    return ERROR_MAC_VALIDATION_FAILED;
+  }
+  if (this->isCancelled())
+    return ERROR_CANCELLED;
+  Metrics::add(Metrics::Counter::FILES_VERIFIED);
+  return ERROR_NONE;
+}
+
+#if defined(SSC_OS_UNIXLIKE)
+SSC_CodeError_t Core::encryptSmallFile(
+ int               fd,
+ uint64_t          input_size,
+ ErrType*          err_type,
+ InOutDir*         err_dir,
+ StatusCallback_f* status_callback,
+ void*             status_callback_data)
+{
+  PlainOldData* mypod {this->getPod()};
+  *err_type = ErrType::CORE;
+  const uint64_t output_size {Core::getEncryptedSize(input_size, mypod->padding_size, mypod->padding_mode)};
+  if (output_size == 0) {
+    close(fd);
+    return ERROR_INVALID_PADDING;
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::MAP_FILES);
+  // Like the mapped output, the output file must not exist yet.
+  const int out_fd {open(mypod->output_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666)};
+  if (out_fd == -1) {
+    const bool exists {errno == EEXIST};
+    close(fd);
+    this->endPhase(Phase::MAP_FILES);
+    *err_dir = InOutDir::OUTPUT;
+    return exists ? ERROR_OUTPUT_FILE_EXISTS : ERROR_OUTPUT_MEMMAP_FAILED;
+  }
+  if (this->small_file_arena.size() < input_size + output_size)
+    this->small_file_arena.resize(input_size + output_size);
+  uint8_t* const in  {this->small_file_arena.data()};
+  uint8_t* const out {in + input_size};
+  const bool     got {read_whole(fd, in, input_size)};
+  close(fd);
+  this->endPhase(Phase::MAP_FILES, input_size);
+  SSC_CodeError_t err {ERROR_INPUT_MEMMAP_FAILED};
+  uint64_t        written {0};
+  if (got) {
+    err = this->encryptBuffer({out, output_size}, {in, input_size}, &written, status_callback, status_callback_data);
+    if (err == ERROR_NONE) {
+      if (status_callback != nullptr)
+        status_callback(status_callback_data);
+      this->beginPhase(Phase::SYNC);
+      if (not write_whole(out_fd, out, written))
+        err = ERROR_OUTPUT_MEMMAP_FAILED;
+      this->endPhase(Phase::SYNC, written);
+    }
+  }
+  close(out_fd);
+  SSC_secureZero(in, input_size + output_size);
+  if (err != ERROR_NONE) {
+    // Don't leave a truncated output file behind.
+    this->wipeKeys();
+    remove(mypod->output_filename);
+    if (err == ERROR_INPUT_MEMMAP_FAILED)
+      *err_dir = InOutDir::INPUT;
+    else if (err == ERROR_OUTPUT_MEMMAP_FAILED)
+      *err_dir = InOutDir::OUTPUT;
+    return err;
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  Metrics::add(Metrics::Counter::FILES_ENCRYPTED);
+  return ERROR_NONE;
+}
+
+SSC_CodeError_t Core::decryptSmallFile(
+ int               fd,
+ uint64_t          input_size,
+ ErrType*          err_type,
+ InOutDir*         err_dir,
+ StatusCallback_f* status_callback,
+ void*             status_callback_data)
+{
+  PlainOldData* mypod {this->getPod()};
+  *err_type = ErrType::CORE;
+  if (input_size < Core::getMinimumOutputSize()) {
+    close(fd);
+    *err_dir = InOutDir::INPUT;
+    return ERROR_INPUT_FILESIZE_TOO_SMALL;
+  }
+  // Report an existing output file before the password and KDF; it's only created once the MAC is valid.
+  if (SSC_FilePath_exists(mypod->output_filename)) {
+    close(fd);
+    *err_dir = InOutDir::OUTPUT;
+    return ERROR_OUTPUT_FILE_EXISTS;
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::MAP_FILES);
+  // The plaintext is never larger than the ciphertext.
+  if (this->small_file_arena.size() < input_size * 2)
+    this->small_file_arena.resize(input_size * 2);
+  uint8_t* const in  {this->small_file_arena.data()};
+  uint8_t* const out {in + input_size};
+  const bool     got {read_whole(fd, in, input_size)};
+  close(fd);
+  this->endPhase(Phase::MAP_FILES, input_size);
+  SSC_CodeError_t err     {ERROR_INPUT_MEMMAP_FAILED};
+  uint64_t        num_out {0};
+  bool            created {false};
+  // The file was read with the size it was opened with, so unlike the mapped path there's nothing to re-check.
+  if (got and memcmp(in, Core::magic, sizeof(Core::magic)) != 0)
+    err = ERROR_INVALID_4CRYPT_FILE;
+  else if (got) {
+    err = this->decryptBuffer({out, input_size}, {in, input_size}, &num_out, status_callback, status_callback_data);
+    if (err == ERROR_NONE) {
+      if (status_callback != nullptr)
+        status_callback(status_callback_data);
+      this->beginPhase(Phase::SYNC);
+      const int out_fd {open(mypod->output_filename, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666)};
+      if (out_fd == -1)
+        err = (errno == EEXIST) ? ERROR_OUTPUT_FILE_EXISTS : ERROR_OUTPUT_MEMMAP_FAILED;
+      else {
+        created = true;
+        if (not write_whole(out_fd, out, num_out))
+          err = ERROR_OUTPUT_MEMMAP_FAILED;
+        close(out_fd);
+      }
+      this->endPhase(Phase::SYNC, num_out);
+    }
+  }
+  SSC_secureZero(in, input_size * 2);
+  if (err != ERROR_NONE) {
+    this->wipeKeys();
+    // Don't leave partial plaintext behind, nor remove a file that appeared meanwhile.
+    if (created)
+      remove(mypod->output_filename);
+    if (err == ERROR_OUTPUT_MEMMAP_FAILED or err == ERROR_OUTPUT_FILE_EXISTS)
+      *err_dir = InOutDir::OUTPUT;
+    else if (err != ERROR_KDF_FAILED and err != ERROR_CANCELLED)
+      *err_dir = InOutDir::INPUT;
+    return err;
+  }
+  Metrics::add(Metrics::Counter::FILES_DECRYPTED);
+  return ERROR_NONE;
+}
+#endif
+
+/* The same steps as encrypt(), minus the file mapping and synchronization: the header, ciphertext
+ * and MAC are written straight into @output, and @input is read exactly once.
+ */
+SSC_CodeError_t Core::encryptBuffer(
+ std::span<uint8_t>       output,
+ std::span<const uint8_t> input,
+ uint64_t*                output_size,
+ StatusCallback_f*        status_callback,
+ void*                    status_callback_data)
+{
+  PlainOldData* mypod {this->getPod()};
+  this->startProgress(0);
+  if (this->normalizePadding(input.size()) != SSC_OK)
+    return ERROR_INVALID_PADDING;
+  const uint64_t size {input.size() + mypod->padding_size + Core::getMetadataSize()};
+  *output_size = size;
+  if (output.size() < size)
+    return ERROR_BUFFER_TOO_SMALL;
+  this->startProgress((mypod->padding_size + input.size()) + (size - MAC_SIZE));
+  if (mypod->password_size == 0) {
+    this->beginPhase(Phase::PASSWORD);
+    this->getPassword(not (mypod->flags & Core::ENTER_PASS_ONCE), false);
+    if (mypod->flags & Core::SUPPLEMENT_ENTROPY)
+      this->getPassword(false, true);
+    this->endPhase(Phase::PASSWORD);
+  }
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::RANDOM);
+  this->genRandomElements();
+  this->endPhase(Phase::RANDOM, TSC_THREEFISH512_TWEAK_BYTES + sizeof(mypod->catena_salt) + sizeof(mypod->tf_ctr_iv));
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::KDF);
+  SSC_CodeError_t err {this->runKDF()};
+  this->endPhase(Phase::KDF);
+  if (err)
+    return err;
+  uint8_t* out {output.data()};
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::HEADER);
+  out = this->writeHeader(out, size);
+  this->endPhase(Phase::HEADER, Core::getHeaderSize());
+  this->beginPhase(Phase::CIPHER);
+  out = this->writeCiphertext(out, input.data(), input.size());
+  this->endPhase(Phase::CIPHER, mypod->padding_size + input.size());
+  if (out == nullptr or this->isCancelled())
+    return this->abandon();
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::MAC);
+  this->writeMAC(out, output.data(), size - MAC_SIZE);
+  this->advanceProgress(size - MAC_SIZE);
+  this->endPhase(Phase::MAC, size - MAC_SIZE);
+  Metrics::add(Metrics::Counter::BYTES_ENCRYPTED, input.size());
+  return ERROR_NONE;
+}
+
+SSC_CodeError_t Core::encryptBuffer(
+ std::unique_ptr<uint8_t[]>* output,
+ uint64_t*                   output_size,
+ std::span<const uint8_t>    input)
+{
+  PlainOldData*  mypod {this->getPod()};
+  const uint64_t size  {Core::getEncryptedSize(input.size(), mypod->padding_size, mypod->padding_mode)};
+  if (size == 0)
+    return ERROR_INVALID_PADDING;
+  // Every byte gets overwritten, so skip value-initialization.
+  std::unique_ptr<uint8_t[]> buffer {new uint8_t[size]};
+  const SSC_CodeError_t err {this->encryptBuffer({buffer.get(), size}, input, output_size)};
+  if (err == ERROR_NONE)
+    *output = std::move(buffer);
+  return err;
+}
+
+/* The same steps as decrypt(), minus the file mapping and synchronization. Nothing is written to
+ * @output unless the MAC is valid.
+ */
+SSC_CodeError_t Core::decryptBuffer(
+ std::span<uint8_t>       output,
+ std::span<const uint8_t> input,
+ uint64_t*                output_size,
+ StatusCallback_f*        status_callback,
+ void*                    status_callback_data)
+{
+  PlainOldData*  mypod  {this->getPod()};
+  const uint64_t num_in {input.size()};
+  this->startProgress(0);
+  if (num_in < Core::getMinimumOutputSize())
+    return ERROR_INPUT_FILESIZE_TOO_SMALL;
+  if (num_in % PAD_FACTOR)
+    return ERROR_INVALID_4CRYPT_FILE;
+  this->startProgress((num_in - MAC_SIZE) + (num_in - Core::getMetadataSize()));
+  if (mypod->password_size == 0) {
+    this->beginPhase(Phase::PASSWORD);
+    this->getPassword(false, false);
+    this->endPhase(Phase::PASSWORD);
+  }
+  const uint8_t*  in  {input.data()};
+  SSC_CodeError_t err {0};
+  this->beginPhase(Phase::HEADER);
+  in = this->readHeaderPlaintext(in, num_in, &err);
+  this->endPhase(Phase::HEADER);
+  if (err)
+    return err;
+  PlainOldData::touchup(*mypod);
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::KDF);
+  err = this->runKDF();
+  this->endPhase(Phase::KDF);
+  if (err)
+    return err;
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::MAC);
+  err = this->verifyMAC(input.data() + (num_in - MAC_SIZE), input.data(), num_in - MAC_SIZE);
+  this->advanceProgress(num_in - MAC_SIZE);
+  this->endPhase(Phase::MAC, num_in - MAC_SIZE);
+  if (err)
+    return ERROR_MAC_VALIDATION_FAILED;
+  if (this->isCancelled())
+    return this->abandon();
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::HEADER);
+  in = this->readHeaderCiphertext(in, &err);
+  this->endPhase(Phase::HEADER, Core::getHeaderSize());
+  if (err)
+    return err;
+  // The MAC covers the padding size, but guard against a padding size larger than the file all the same.
+  if (mypod->padding_size > num_in - Core::getMetadataSize())
+    return ERROR_METADATA_VALIDATION_FAILED;
+  this->progress_total -= mypod->padding_size;
+  this->advanceProgress(0);
+  const uint64_t num_out {num_in - Core::getMetadataSize() - mypod->padding_size};
+  *output_size = num_out;
+  if (output.size() < num_out)
+    return ERROR_BUFFER_TOO_SMALL;
+  if (status_callback != nullptr)
+    status_callback(status_callback_data);
+  this->beginPhase(Phase::CIPHER);
+  err = this->writePlaintext(output.data(), in, num_out);
+  this->endPhase(Phase::CIPHER, num_out);
+  if (err) {
+    // Don't leave partial plaintext behind.
+    SSC_secureZero(output.data(), num_out);
+    return this->abandon();
+  }
+  Metrics::add(Metrics::Counter::BYTES_DECRYPTED, num_out);
+  return ERROR_NONE;
+}
+
+SSC_CodeError_t Core::decryptBuffer(
+ std::unique_ptr<uint8_t[]>* output,
+ uint64_t*                   output_size,
+ std::span<const uint8_t>    input)
+{
+  // The padding size is only known once the header is deciphered, so allocate for the largest possible plaintext.
+  const uint64_t bound {Core::getDecryptedSizeBound(input.size())};
+  if (bound == 0)
+    return ERROR_INPUT_FILESIZE_TOO_SMALL;
+  std::unique_ptr<uint8_t[]> buffer {new uint8_t[bound]};
+  const SSC_CodeError_t err {this->decryptBuffer({buffer.get(), bound}, input, output_size)};
+  if (err == ERROR_NONE)
+    *output = std::move(buffer);
+  return err;
+}
+
+SSC_Error_t Core::syncMaps()
+{
+  PlainOldData* mypod {this->getPod()};
+  SSC_Error_t   err   {SSC_OK};
+  FOURCRYPT_PROBE2(sync_entry, mypod->input_map.size, mypod->output_map.size);
+  if (mypod->input_map.ptr && SSC_MemMap_sync(&mypod->input_map))
+    err = SSC_ERR;
+  else if (mypod->output_map.ptr && SSC_MemMap_sync(&mypod->output_map))
+    err = SSC_ERR;
+  FOURCRYPT_PROBE1(sync_return, err);
+  return err;
 }
 
 void Core::unmapFiles()
 {
   PlainOldData* mypod {this->getPod()};
-  if (mypod->input_map.ptr)
+  // Forget each map once it's deleted, so that this may be called again, e.g. by reset().
+  if (mypod->input_map.ptr) {
     SSC_MemMap_del(&mypod->input_map);
-  if (mypod->output_map.ptr)
+    mypod->input_map = SSC_MEMMAP_NULL_LITERAL;
+  }
+  if (mypod->output_map.ptr) {
     SSC_MemMap_del(&mypod->output_map);
+    mypod->output_map = SSC_MEMMAP_NULL_LITERAL;
+  }
 }
 
 const uint8_t* Core::readHeaderPlaintext(
  const uint8_t* R_   from,
+ const uint64_t      file_size,
  SSC_CodeError_t* R_ err)
 {
   PlainOldData* mypod {this->getPod()};
@@ -600,7 +1591,7 @@ const uint8_t* Core::readHeaderPlaintext(
     from += sizeof(size);
     if constexpr(not Core::is_little_endian)
       size = SSC_swap64(size);
-    if (mypod->input_map.size != size) {
+    if (file_size != size) {
       *err = ERROR_INPUT_SIZE_MISMATCH;
       return from;
     }
@@ -702,13 +1693,15 @@ SSC_CodeError_t Core::describe(
   }
   const uint8_t* in     {mypod->input_map.ptr};
   const uint64_t num_in {mypod->input_map.size};
-  in = this->readHeaderPlaintext(in, &err);
+  in = this->readHeaderPlaintext(in, num_in, &err);
   if (err) {
+    this->unmapFiles();
     *errdir = InOutDir::NONE;
     *errtype = ErrType::CORE;
     return err;
   }
   if (not Core::verifyBasicMetadata(mypod, InOutDir::INPUT)) {
+    this->unmapFiles();
     *errdir = InOutDir::INPUT;
     *errtype = ErrType::CORE;
     return ERROR_METADATA_VALIDATION_FAILED;
@@ -744,6 +1737,7 @@ SSC_CodeError_t Core::describe(
   printf("\nThreefish512 CTR-Mode's IV is...0x");
   SSC_printBytes(mypod->tf_ctr_iv, sizeof(mypod->tf_ctr_iv));
   putchar('\n');
+  this->unmapFiles();
   return 0;
 }
 
@@ -759,6 +1753,10 @@ SSC_CodeError_t Core::mapFiles(InOutDir* map_err_idx, size_t input_size, size_t
 
   PlainOldData*   mypod {this->getPod()};
   SSC_CodeError_t err   {0};
+  FOURCRYPT_PROBE2(
+   map_entry,
+   only_map != InOutDir::OUTPUT ? input_size : 0,
+   only_map != InOutDir::INPUT ? output_size : 0);
   // Input and output filenames have been checked for NULL. Map these filepaths.
   if (only_map != InOutDir::OUTPUT) {
     err = SSC_MemMap_init(
@@ -769,6 +1767,7 @@ SSC_CodeError_t Core::mapFiles(InOutDir* map_err_idx, size_t input_size, size_t
     if (err) {
       if (map_err_idx)
         *map_err_idx = InOutDir::INPUT;
+      FOURCRYPT_PROBE1(map_return, err);
       return err;
     }
   }
@@ -781,12 +1780,27 @@ SSC_CodeError_t Core::mapFiles(InOutDir* map_err_idx, size_t input_size, size_t
     if (err) {
       if (map_err_idx)
         *map_err_idx = InOutDir::OUTPUT;
+      FOURCRYPT_PROBE1(map_return, err);
       return err;
     }
   }
+  FOURCRYPT_PROBE1(map_return, 0);
   return 0;
 }
 
+void Core::prefetchInput(bool read_once)
+{
+ #if defined(SSC_OS_UNIXLIKE)
+  PlainOldData* mypod {this->getPod()};
+  if (mypod->input_map.ptr == nullptr || mypod->input_map.size == 0)
+    return;
+  // These are only hints; ignore failures.
+  if (read_once)
+    posix_madvise(mypod->input_map.ptr, mypod->input_map.size, POSIX_MADV_SEQUENTIAL);
+  posix_madvise(mypod->input_map.ptr, std::min<uint64_t>(mypod->input_map.size, PREFETCH_WINDOW_BYTES), POSIX_MADV_WILLNEED);
+ #endif
+}
+
 /* Prompt the user for a password to be entered at a command-line terminal. 
  * If @enter_twice is true the user will be prompted a second time to confirm that
  * they entered the password correctly.
@@ -845,7 +1859,7 @@ void Core::getPassword(bool enter_twice, bool entropy)
   }
 }
 
-uint8_t* Core::writeHeader(uint8_t* to)
+uint8_t* Core::writeHeader(uint8_t* to, const uint64_t file_size)
 {
   PlainOldData* mypod {this->getPod()};
   // Magic bytes.
@@ -863,9 +1877,9 @@ uint8_t* Core::writeHeader(uint8_t* to)
   {
     uint64_t size;
     if constexpr(Core::is_little_endian)
-      size = mypod->output_map.size;
+      size = file_size;
     else
-      size = SSC_swap64(mypod->output_map.size);
+      size = SSC_swap64(file_size);
     memcpy(to, &size, sizeof(size));
     to += sizeof(size);
   }
@@ -911,47 +1925,88 @@ uint8_t* Core::writeHeader(uint8_t* to)
   return to;
 }
 
+/* Apply one tile of the keystream with @ctr, starting at keystream index @idx. */
+static void
+apply_tile(TSC_Threefish512Ctr* ctr, uint8_t* R_ to, const uint8_t* R_ from, uint64_t n, uint64_t idx)
+{
+  FOURCRYPT_PROBE2(ctr_tile, idx, n);
+  Trace::begin("ctr_tile", "ctr", idx);
+  if (from != nullptr)
+    TSC_Threefish512Ctr_xor_2(ctr, to, from, n, idx);
+  else
+    TSC_Threefish512Ctr_xor_1(ctr, to, n, idx);
+  Trace::end("ctr_tile", "ctr", n);
+}
+
+uint8_t* Core::applyKeystream(uint8_t* R_ to, const uint8_t* R_ from, uint64_t num)
+{
+  PlainOldData*  mypod {this->getPod()};
+  const uint64_t tiles {(num + CTR_TILE_BYTES - 1) / CTR_TILE_BYTES};
+  Executor*      ex    {nullptr};
+  // Performance counters follow this thread and the threads it spawns, but not the executor's
+  // long-lived workers; when profiling, apply every tile here so the counters see all of them.
+  if (tiles > 1 and not (mypod->flags & Core::PROFILE_COUNTERS))
+    ex = (this->executor != nullptr) ? this->executor : &Executor::global();
+  if (ex == nullptr or ex->threadCount() < 2) {
+    while (num != 0) {
+      if (this->isCancelled())
+        return nullptr;
+      const uint64_t n {std::min(num, CTR_TILE_BYTES)};
+      apply_tile(&mypod->tf_ctr, to, from, n, mypod->tf_ctr_idx);
+      if (from != nullptr)
+        from += n;
+      to                += n;
+      mypod->tf_ctr_idx += n;
+      num               -= n;
+      this->advanceProgress(n);
+    }
+    return to;
+  }
+  // Tiles are independent given their keystream index. Each lane works on a private copy of the
+  // cipher, and the calling thread alone publishes progress and observes cancellation between rounds.
+  const uint64_t round_tiles {(static_cast<uint64_t>(ex->threadCount()) + 1) * CTR_ROUND_TILES_PER_LANE};
+  const uint64_t first_idx   {mypod->tf_ctr_idx};
+  for (uint64_t first {0}; first < tiles; first += round_tiles) {
+    if (this->isCancelled())
+      return nullptr;
+    const uint64_t count {std::min(round_tiles, tiles - first)};
+    ex->parallelFor(count, [&](uint64_t i) {
+      const uint64_t     offset {(first + i) * CTR_TILE_BYTES};
+      TSC_Threefish512Ctr ctr   {mypod->tf_ctr};
+      apply_tile(&ctr, to + offset, (from != nullptr) ? from + offset : nullptr, std::min(num - offset, CTR_TILE_BYTES), first_idx + offset);
+      SSC_secureZero(&ctr, sizeof(ctr));
+    });
+    this->advanceProgress(std::min(num, (first + count) * CTR_TILE_BYTES) - (first * CTR_TILE_BYTES));
+  }
+  mypod->tf_ctr_idx += num;
+  return to + num;
+}
+
 uint8_t* Core::writeCiphertext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num)
 {
   PlainOldData* mypod {this->getPod()};
+  FOURCRYPT_PROBE2(encipher_entry, num, mypod->padding_size);
   // Encipher padding bytes, if applicable.
-  if (mypod->padding_size != 0) {
-    TSC_Threefish512Ctr_xor_1(
-      &mypod->tf_ctr,
-      to,
-      mypod->padding_size,
-      mypod->tf_ctr_idx);
-    to                += mypod->padding_size;
-    mypod->tf_ctr_idx += mypod->padding_size;
-  }
+  to = this->applyKeystream(to, nullptr, mypod->padding_size);
   // Encipher the plaintext.
-  TSC_Threefish512Ctr_xor_2(
-    &mypod->tf_ctr,
-    to,
-    from,
-    num,
-    mypod->tf_ctr_idx);
-  to                += num;
-  mypod->tf_ctr_idx += num;
+  if (to != nullptr)
+    to = this->applyKeystream(to, from, num);
+  FOURCRYPT_PROBE2(encipher_return, num, mypod->padding_size);
   return to;
 }
 
-void Core::writePlaintext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num)
+SSC_Error_t Core::writePlaintext(uint8_t* R_ to, const uint8_t* R_ from, const size_t num)
 {
-  PlainOldData* mypod {this->getPod()};
-  TSC_Threefish512Ctr_xor_2(
-    &mypod->tf_ctr,
-    to,
-    from,
-    num,
-    mypod->tf_ctr_idx);
-  to += num;
-  mypod->tf_ctr_idx += num;
+  FOURCRYPT_PROBE1(decipher_entry, num);
+  const SSC_Error_t err {(this->applyKeystream(to, from, num) != nullptr) ? SSC_OK : SSC_ERR};
+  FOURCRYPT_PROBE1(decipher_return, num);
+  return err;
 }
 
 void Core::writeMAC(uint8_t* R_ to, const uint8_t* R_ from, const size_t num)
 {
   PlainOldData* mypod {this->getPod()};
+  FOURCRYPT_PROBE1(mac_entry, num);
   TSC_Skein512_mac(
     mypod->skein512,
     to,
@@ -959,6 +2014,7 @@ void Core::writeMAC(uint8_t* R_ to, const uint8_t* R_ from, const size_t num)
     from,
     num,
     mypod->mac_key);
+  FOURCRYPT_PROBE1(mac_return, num);
 }
 
 bool Core::verifyBasicMetadata(
@@ -1085,8 +2141,9 @@ std::string Core::makeMemoryString(const uint64_t value)
 uint8_t
 Core::getDefaultMemoryUsageBitShift(void)
 {
-#ifdef SSC_HAS_GETAVAILABLESYSTEMMEMORY
-  const uint64_t available {static_cast<uint64_t>(SSC_getAvailableSystemMemory())};
+  const uint64_t available {Resources::detect().availableMemory()};
+  if (available == 0)
+    return MEM_NORMAL;
 
   // Scan through all the bits until the highest bit is detected. Determine the equivalent bit shift from 0.
   {
@@ -1104,7 +2161,4 @@ Core::getDefaultMemoryUsageBitShift(void)
 
     return shift;
   }
-#else
-  return MEM_NORMAL;
-#endif
 }
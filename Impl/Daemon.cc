@@ -0,0 +1,101 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Daemon.hh"
+#include "LocalSocket.hh"
+// SSC
+#include <SSC/Memory.h>
+// C++ C Lib
+#include <cstdlib>
+using namespace fourcrypt;
+
+std::string
+Daemon::socketPath(void)
+{
+  if (const char* sock {std::getenv("FOURCRYPT_DAEMON_SOCK")}; sock != nullptr and sock[0] != '\0')
+    return sock;
+  return local_socket_path("daemon");
+}
+
+bool
+Daemon::sendJob(int fd, const Session::Job& job, const uint8_t* password, size_t password_size)
+{
+  if (job.input.size() > MAX_PATH_BYTES or job.output.size() > MAX_PATH_BYTES or password_size > Core::MAX_PW_BYTES)
+    return false;
+  Request req {};
+  req.version           = PROTOCOL_VERSION;
+  req.mode              = static_cast<uint8_t>(job.mode);
+  req.preset            = static_cast<uint8_t>(job.preset);
+  req.flags             = job.flags;
+  req.memory_low        = job.memory_low;
+  req.memory_high       = job.memory_high;
+  req.iterations        = job.iterations;
+  req.padding_mode      = static_cast<uint8_t>(job.padding_mode);
+  req.thread_count      = job.thread_count;
+  req.thread_batch_size = job.thread_batch_size;
+  req.padding_size      = job.padding_size;
+  req.input_size        = static_cast<uint16_t>(job.input.size());
+  req.output_size       = static_cast<uint16_t>(job.output.size());
+  req.password_size     = static_cast<uint16_t>(password_size);
+  return
+   local_send_all(fd, &req, sizeof(req)) and
+   local_send_all(fd, job.input.data(), job.input.size()) and
+   local_send_all(fd, job.output.data(), job.output.size()) and
+   local_send_all(fd, password, password_size);
+}
+
+bool
+Daemon::recvJob(int fd, Session::Job* job)
+{
+  Request req {};
+  if (not local_recv_all(fd, &req, sizeof(req)) or req.version != PROTOCOL_VERSION)
+    return false;
+  const auto mode {static_cast<Core::ExeMode>(req.mode)};
+  if (mode != Core::ExeMode::ENCRYPT and mode != Core::ExeMode::DECRYPT and mode != Core::ExeMode::VERIFY)
+    return false;
+  if (req.preset > static_cast<uint8_t>(Session::Preset::STRONG) or req.padding_mode > static_cast<uint8_t>(Core::PadMode::AS_IF))
+    return false;
+  if (req.input_size == 0 or req.input_size > MAX_PATH_BYTES or req.output_size > MAX_PATH_BYTES)
+    return false;
+  if (req.password_size == 0 or req.password_size > Core::MAX_PW_BYTES)
+    return false;
+  if (req.thread_count == 0 or req.iterations == 0 or req.memory_high >= 58 or req.memory_low > req.memory_high)
+    return false;
+  job->input.resize(req.input_size);
+  job->output.resize(req.output_size);
+  uint8_t password [Core::MAX_PW_BYTES];
+  const bool ok {
+   local_recv_all(fd, job->input.data(), req.input_size) and
+   local_recv_all(fd, job->output.data(), req.output_size) and
+   local_recv_all(fd, password, req.password_size) and
+   job->setPassword(password, req.password_size)
+  };
+  SSC_secureZero(password, sizeof(password));
+  if (not ok or job->input.front() != '/' or (not job->output.empty() and job->output.front() != '/'))
+    return false;
+  job->mode              = mode;
+  job->preset            = static_cast<Session::Preset>(req.preset);
+  // Nothing may prompt on the daemon's terminal or print to it.
+  job->flags             = req.flags & (Core::ENABLE_PHI | Core::DISABLE_NUMA | Core::USE_AGENT);
+  job->memory_low        = req.memory_low;
+  job->memory_high       = req.memory_high;
+  job->iterations        = req.iterations;
+  job->padding_mode      = static_cast<Core::PadMode>(req.padding_mode);
+  job->thread_count      = req.thread_count;
+  job->thread_batch_size = req.thread_batch_size;
+  job->padding_size      = req.padding_size;
+  return true;
+}
@@ -0,0 +1,251 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Local
+#include "Daemon.hh"
+#include "LocalSocket.hh"
+#include "fourcrypt.h"
+// SSC
+#include <SSC/CommandLineArg.h>
+#include <SSC/Error.h>
+#include <SSC/Memory.h>
+#include <SSC/Terminal.h>
+// C++ STL
+#include <array>
+#include <filesystem>
+#include <string>
+// C++ C Lib
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <unistd.h>
+#endif
+#define R_ SSC_RESTRICT
+using namespace fourcrypt;
+
+/* Submit one job to 4cryptd and follow its progress until it finishes. */
+struct Options
+ {
+  Session::Job job         {};
+  std::string  socket_path {};
+  bool         mode_set    {false};
+ };
+
+static void
+print_help(void)
+{
+  std::puts(
+   "Usage: 4cryptctl (--encrypt|--decrypt|--verify)=<filepath> [options]\n"
+   "Submit a job to 4cryptd and print its progress until it finishes.\n"
+   "-h, --help                  Print help output.\n"
+   "-e, --encrypt=<filepath>    Encrypt the file at the filepath.\n"
+   "-d, --decrypt=<filepath>    Decrypt the file at the filepath.\n"
+   "--verify=<filepath>         Check the password and integrity of the encrypted file at the filepath.\n"
+   "-o, --output=<filepath>     Specify an output filepath.\n"
+   "--preset=<fast|normal|strong>\n"
+   "                            Choose the KDF parameters of an encryption.\n"
+   "--socket=<filepath>         Connect here instead of $FOURCRYPT_DAEMON_SOCK, $XDG_RUNTIME_DIR/4crypt-daemon.sock\n"
+   "                              or /tmp/4crypt-<uid>/daemon.sock.");
+}
+
+/* Record @mode and the absolute path of @path in @opt; the daemon doesn't share our working directory. */
+static SSC_Error_t
+set_mode(Options* opt, Core::ExeMode mode, const char* path, size_t size)
+{
+  SSC_assertMsg(not opt->mode_set, "Error: Only one of --encrypt, --decrypt and --verify may be given!\n");
+  opt->mode_set  = true;
+  opt->job.mode  = mode;
+  opt->job.input = std::filesystem::absolute(std::string{path, size}).string();
+  return SSC_OK;
+}
+
+#define ARGS_ const int argc, char** R_ argv, const int offset, void* R_ data
+#define PATH_OPTION_(name, mode) \
+static int \
+ctl_##name(ARGS_) \
+{ \
+  SSC_ArgParser parser; \
+  return SSC_ArgParser_process( \
+   &parser, argc, argv, offset, data, nullptr, \
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t { \
+     return set_mode(static_cast<Options*>(dt), mode, ap->to_read, ap->size); \
+   }); \
+}
+PATH_OPTION_(decrypt, Core::ExeMode::DECRYPT)
+PATH_OPTION_(encrypt, Core::ExeMode::ENCRYPT)
+PATH_OPTION_(verify , Core::ExeMode::VERIFY)
+#undef PATH_OPTION_
+
+static int
+ctl_help(ARGS_)
+{
+  print_help();
+  std::exit(EXIT_SUCCESS);
+  return 0;
+}
+
+static int
+ctl_output(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Options*>(dt)->job.output = std::filesystem::absolute(std::string{ap->to_read, ap->size}).string();
+     return SSC_OK;
+   });
+}
+
+static int
+ctl_preset(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     Session::Job& job {static_cast<Options*>(dt)->job};
+     if (strcmp(ap->to_read, "fast") == 0)
+       job.preset = Session::Preset::FAST;
+     else if (strcmp(ap->to_read, "normal") == 0)
+       job.preset = Session::Preset::NORMAL;
+     else if (strcmp(ap->to_read, "strong") == 0)
+       job.preset = Session::Preset::STRONG;
+     else
+       SSC_errx("Invalid preset '%s'! Expected fast, normal or strong.\n", ap->to_read);
+     return SSC_OK;
+   });
+}
+
+static int
+ctl_socket(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Options*>(dt)->socket_path.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+#undef ARGS_
+
+const std::array<SSC_ArgShort, 4> shorts = {{
+  SSC_ARGSHORT_LITERAL(ctl_decrypt, 'd'),
+  SSC_ARGSHORT_LITERAL(ctl_encrypt, 'e'),
+  SSC_ARGSHORT_LITERAL(ctl_help,    'h'),
+  SSC_ARGSHORT_LITERAL(ctl_output,  'o'),
+}};
+
+const std::array<SSC_ArgLong, 7> longs = {{
+  SSC_ARGLONG_LITERAL(ctl_decrypt, "decrypt"),
+  SSC_ARGLONG_LITERAL(ctl_encrypt, "encrypt"),
+  SSC_ARGLONG_LITERAL(ctl_help,    "help"),
+  SSC_ARGLONG_LITERAL(ctl_output,  "output"),
+  SSC_ARGLONG_LITERAL(ctl_preset,  "preset"),
+  SSC_ARGLONG_LITERAL(ctl_socket,  "socket"),
+  SSC_ARGLONG_LITERAL(ctl_verify,  "verify"),
+}};
+
+int main(int argc, char* argv[])
+{
+  Options opt {};
+  if (argc > 1) {
+    SSC_processCommandLineArgs(
+     argc - 1,
+     argv + 1,
+     shorts.size(),
+     shorts.data(),
+     longs.size(),
+     longs.data(),
+     &opt,
+     nullptr);
+  }
+  if (not opt.mode_set) {
+    print_help();
+    return EXIT_FAILURE;
+  }
+  if (opt.socket_path.empty())
+    opt.socket_path = Daemon::socketPath();
+  const int fd {local_connect(opt.socket_path, Daemon::TIMEOUT_MILLISECONDS)};
+  if (fd == -1) {
+    std::fprintf(stderr, "Error: No 4cryptd of this user is listening on %s!\n", opt.socket_path.c_str());
+    return EXIT_FAILURE;
+  }
+  // Only ask for the password once the daemon is known to be there.
+  uint8_t password [Core::PW_BUFFER_BYTES];
+  uint8_t verify   [Core::PW_BUFFER_BYTES];
+  SSC_Terminal_init();
+  int password_size;
+  if (opt.job.mode == Core::ExeMode::ENCRYPT)
+    password_size = SSC_Terminal_getPasswordChecked(
+     password, verify, "Please input a password.\n", "Please input the same password again.\n", 1, Core::MAX_PW_BYTES, Core::PW_BUFFER_BYTES);
+  else
+    password_size = SSC_Terminal_getPassword(password, "Please input a password.\n", 1, Core::MAX_PW_BYTES, Core::PW_BUFFER_BYTES);
+  SSC_Terminal_end();
+  SSC_secureZero(verify, sizeof(verify));
+  const bool sent {Daemon::sendJob(fd, opt.job, password, static_cast<size_t>(password_size))};
+  SSC_secureZero(password, sizeof(password));
+  // The daemon only answers slowly while it is busy, so wait for events indefinitely from here on.
+  local_set_timeouts(fd, 0);
+  Daemon::Event ev {};
+  bool          got {sent and local_recv_all(fd, &ev, sizeof(ev))};
+  if (not got or ev.kind != Daemon::EventKind::QUEUED) {
+    std::fputs("Error: 4cryptd rejected the job!\n", stderr);
+    close(fd);
+    return EXIT_FAILURE;
+  }
+  std::fprintf(stderr, "Queued as job %" PRIu64 ".\n", ev.job_id);
+  while ((got = local_recv_all(fd, &ev, sizeof(ev))) and ev.kind != Daemon::EventKind::DONE) {
+    if (ev.kind != Daemon::EventKind::PROGRESS)
+      continue;
+    const char* phase {Core::phaseName(static_cast<Core::Phase>(ev.phase))};
+    if (ev.bytes_total != 0)
+      std::fprintf(stderr, "\r%-11s %5.1f%%   ", phase, 100.0 * static_cast<double>(ev.bytes_done) / static_cast<double>(ev.bytes_total));
+    else
+      std::fprintf(stderr, "\r%-11s         ", phase);
+  }
+  std::fputc('\n', stderr);
+  close(fd);
+  if (not got) {
+    std::fputs("Error: Lost the connection to 4cryptd!\n", stderr);
+    return EXIT_FAILURE;
+  }
+  if (ev.code == 0)
+    return EXIT_SUCCESS;
+  if (static_cast<Core::ErrType>(ev.error_type) == Core::ErrType::CORE)
+    std::fprintf(stderr, "Error: %s\n", fourcrypt_strerror(ev.code));
+  else
+    std::fprintf(stderr, "Error: Memory-mapping the %s file failed (%d)!\n",
+     static_cast<Core::InOutDir>(ev.error_dir) == Core::InOutDir::OUTPUT ? "output" : "input", ev.code);
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,419 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+// Local
+#include "Calibration.hh"
+#include "Daemon.hh"
+#include "Executor.hh"
+#include "LocalSocket.hh"
+#include "MemoryBudget.hh"
+#include "Metrics.hh"
+#include "Resources.hh"
+#include "Util.hh"
+// SSC
+#include <SSC/CommandLineArg.h>
+#include <SSC/Error.h>
+// C++ STL
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// C++ C Lib
+#include <cerrno>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <poll.h>
+ #include <sys/socket.h>
+ #include <unistd.h>
+#endif
+#define R_ SSC_RESTRICT
+using namespace fourcrypt;
+
+#if !defined(SSC_OS_UNIXLIKE)
+int main(void)
+{
+  std::fputs("4cryptd requires Unix domain sockets.\n", stderr);
+  return EXIT_FAILURE;
+}
+#else
+
+constexpr int      ACCEPT_POLL_MILLISECONDS {1000};
+constexpr unsigned METRICS_INTERVAL_SECONDS {15};
+constexpr unsigned RECEIVE_THREADS          {4}; // Clients being read from at once; each may take TIMEOUT_MILLISECONDS.
+
+struct Options
+ {
+  std::string socket_path      {};
+  uint64_t    budget           {0}; // 0 for Calibration::defaultMemoryBudget().
+  unsigned    jobs             {0}; // 0 for half the usable processors.
+  std::string metrics_path     {}; // Empty to export no metrics.
+  unsigned    metrics_interval {METRICS_INTERVAL_SECONDS};
+ };
+
+/* One client's job, from the moment it is accepted until its DONE event has been sent. */
+struct JobRecord
+ {
+  uint64_t               id;
+  int                    fd;
+  Session::Job           job         {};
+  Core::CancelToken      cancel      {};
+  std::atomic<Core*>     core        {nullptr}; // Set once the job is running.
+  std::atomic<bool>      done        {false};
+  Session::Result        result      {};
+  bool                   announced   {false};   // Has RUNNING been sent?
+ };
+using Record_t = std::shared_ptr<JobRecord>;
+
+static volatile std::sig_atomic_t stopping {0};
+static Session                    session {};
+static std::mutex                 active_mtx {};
+static std::vector<Record_t>      active {};
+
+static void
+on_stop_signal(int)
+{
+  stopping = 1;
+}
+
+/* Run on a worker of the job executor. Every worker keeps one Core for all the jobs it runs. */
+static void
+run_job(const Record_t& rec)
+{
+  thread_local Core core {};
+  core.setCancelToken(&rec->cancel);
+  rec->core.store(&core, std::memory_order_release);
+  if (rec->cancel.isCancelled())
+    rec->result.code = Core::ERROR_CANCELLED;
+  else
+    rec->result = session.run(rec->job, core);
+  rec->job.clearPassword();
+  core.setCancelToken(nullptr);
+  rec->done.store(true, std::memory_order_release);
+}
+
+static bool
+send_event(JobRecord& rec, Daemon::EventKind kind)
+{
+  Daemon::Event ev {};
+  ev.kind   = kind;
+  ev.job_id = rec.id;
+  ev.phase  = static_cast<uint8_t>(Core::Phase::COUNT);
+  if (kind == Daemon::EventKind::DONE) {
+    ev.code       = static_cast<int32_t>(rec.result.code);
+    ev.error_type = static_cast<uint8_t>(rec.result.type);
+    ev.error_dir  = static_cast<uint8_t>(rec.result.dir);
+  }
+  else if (Core* core {rec.core.load(std::memory_order_acquire)}; core != nullptr) {
+    const Core::Progress p {core->getProgress()->load()};
+    ev.phase       = static_cast<uint8_t>(p.phase);
+    ev.bytes_done  = p.bytes_done;
+    ev.bytes_total = p.bytes_total;
+  }
+  return local_send_all(rec.fd, &ev, sizeof(ev));
+}
+
+/* Run on a worker of the receiving executor: read the job of @rec's client and queue it on @jobs.
+ * Jobs received once the daemon is stopping are turned away, as they would never be cancelled.
+ */
+static void
+receive_job(const Record_t& rec, Executor& jobs)
+{
+  if (not Daemon::recvJob(rec->fd, &rec->job) or not send_event(*rec, Daemon::EventKind::QUEUED)) {
+    close(rec->fd);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock {active_mtx};
+    if (stopping) {
+      close(rec->fd);
+      return;
+    }
+    active.push_back(rec);
+  }
+  jobs.post([rec]() { run_job(rec); });
+}
+
+/* Has the client of @rec hung up? */
+static bool
+client_gone(const JobRecord& rec)
+{
+  uint8_t byte;
+  const ssize_t n {recv(rec.fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT)};
+  return n == 0 or (n < 0 and errno != EAGAIN and errno != EWOULDBLOCK);
+}
+
+/* Stream the progress of every active job to its client, and finish the jobs that are done.
+ * A job whose client hangs up or stops reading is cancelled; one still waiting in the queue is
+ * dropped outright, so that it never gets to run its KDF.
+ */
+static void
+report(const std::atomic<bool>* finished)
+{
+  for (;;) {
+    const bool last {finished->load(std::memory_order_acquire)};
+    std::vector<Record_t> snapshot {};
+    {
+      std::lock_guard<std::mutex> lock {active_mtx};
+      snapshot = active;
+    }
+    for (const Record_t& rec : snapshot) {
+      if (rec->done.load(std::memory_order_acquire)) {
+        send_event(*rec, Daemon::EventKind::DONE);
+        close(rec->fd);
+        std::lock_guard<std::mutex> lock {active_mtx};
+        std::erase(active, rec);
+        continue;
+      }
+      if (rec->core.load(std::memory_order_acquire) == nullptr) {
+        if (client_gone(*rec)) {
+          // run_job() skips cancelled jobs, and no longer needs the connection.
+          rec->cancel.cancel();
+          close(rec->fd);
+          std::lock_guard<std::mutex> lock {active_mtx};
+          std::erase(active, rec);
+        }
+        continue;
+      }
+      bool ok {true};
+      if (not rec->announced) {
+        ok = send_event(*rec, Daemon::EventKind::RUNNING);
+        rec->announced = true;
+      }
+      if (ok)
+        ok = send_event(*rec, Daemon::EventKind::PROGRESS);
+      if (not ok or client_gone(*rec))
+        rec->cancel.cancel();
+    }
+    if (last)
+      return;
+    std::this_thread::sleep_for(std::chrono::milliseconds(Daemon::PROGRESS_MILLISECONDS));
+  }
+}
+
+static void
+print_help(void)
+{
+  std::puts(
+   "Usage: 4cryptd [options]\n"
+   "Queue and run encrypt, decrypt and verify jobs submitted by 4cryptctl, admitting their KDFs\n"
+   "only while their memory fits within a shared budget.\n"
+   "-h, --help                  Print help output.\n"
+   "--socket=<filepath>         Listen here instead of $FOURCRYPT_DAEMON_SOCK, $XDG_RUNTIME_DIR/4crypt-daemon.sock\n"
+   "                              or /tmp/4crypt-<uid>/daemon.sock.\n"
+   "--budget=<mem[K|M|G]>       The memory all concurrent KDFs may use together (default: half the available memory).\n"
+   "--jobs=<num>                How many jobs may run at once (default: half the usable processors).\n"
+   "--metrics=<filepath>        Export counters and latency histograms to this Prometheus textfile periodically.\n"
+   "--metrics-interval=<sec>    How often to export them (default: 15).\n"
+   "The daemon runs in the foreground until SIGINT or SIGTERM, which cancel every job.");
+}
+
+#define ARGS_ const int argc, char** R_ argv, const int offset, void* R_ data
+
+static int
+daemon_budget(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t budget {parse_bytes(ap->to_read, ap->size)};
+     SSC_assertMsg(budget != 0, "Error: Invalid budget '%s'!\n", ap->to_read);
+     static_cast<Options*>(dt)->budget = budget;
+     return SSC_OK;
+   });
+}
+
+static int
+daemon_help(ARGS_)
+{
+  print_help();
+  std::exit(EXIT_SUCCESS);
+  return 0;
+}
+
+static int
+daemon_jobs(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t jobs {parse_integer(ap->to_read, ap->size)};
+     SSC_assertMsg(jobs > 0 and jobs <= 1024, "Error: Invalid job count '%s'!\n", ap->to_read);
+     static_cast<Options*>(dt)->jobs = static_cast<unsigned>(jobs);
+     return SSC_OK;
+   });
+}
+
+static int
+daemon_metrics(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Options*>(dt)->metrics_path.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+
+static int
+daemon_metrics_interval(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     const uint64_t seconds {parse_integer(ap->to_read, ap->size)};
+     SSC_assertMsg(seconds > 0 and seconds <= 86400, "Error: Invalid metrics interval '%s'!\n", ap->to_read);
+     static_cast<Options*>(dt)->metrics_interval = static_cast<unsigned>(seconds);
+     return SSC_OK;
+   });
+}
+
+static int
+daemon_socket(ARGS_)
+{
+  SSC_ArgParser parser;
+  return SSC_ArgParser_process(
+   &parser,
+   argc,
+   argv,
+   offset,
+   data,
+   nullptr,
+   [](SSC_ArgParser* R_ ap, void* R_ dt) -> SSC_Error_t {
+     static_cast<Options*>(dt)->socket_path.assign(ap->to_read, ap->size);
+     return SSC_OK;
+   });
+}
+#undef ARGS_
+
+const std::array<SSC_ArgShort, 1> shorts = {{
+  SSC_ARGSHORT_LITERAL(daemon_help, 'h'),
+}};
+
+const std::array<SSC_ArgLong, 6> longs = {{
+  SSC_ARGLONG_LITERAL(daemon_budget,           "budget"),
+  SSC_ARGLONG_LITERAL(daemon_help,             "help"),
+  SSC_ARGLONG_LITERAL(daemon_jobs,             "jobs"),
+  SSC_ARGLONG_LITERAL(daemon_metrics,          "metrics"),
+  SSC_ARGLONG_LITERAL(daemon_metrics_interval, "metrics-interval"),
+  SSC_ARGLONG_LITERAL(daemon_socket,           "socket"),
+}};
+
+int main(int argc, char* argv[])
+{
+  Options opt {};
+  if (argc > 1) {
+    SSC_processCommandLineArgs(
+     argc - 1,
+     argv + 1,
+     shorts.size(),
+     shorts.data(),
+     longs.size(),
+     longs.data(),
+     &opt,
+     nullptr);
+  }
+  if (opt.socket_path.empty())
+    opt.socket_path = Daemon::socketPath();
+  if (opt.budget == 0)
+    opt.budget = Calibration::defaultMemoryBudget();
+  if (opt.jobs == 0)
+    opt.jobs = static_cast<unsigned>(std::max<uint64_t>(Resources::detect().usableProcessors() / 2, 1));
+  // Never freed: a cancelled KDF returns its reservation from its own thread whenever it finishes.
+  session.setMemoryBudget(new MemoryBudget{opt.budget});
+  if (not opt.metrics_path.empty())
+    Metrics::start(opt.metrics_path, opt.metrics_interval);
+
+  const int server {local_listen(opt.socket_path)};
+  struct sigaction sa {};
+  sa.sa_handler = &on_stop_signal;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT , &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+  std::fprintf(
+   stderr,
+   "4cryptd listening on %s: %u concurrent jobs within a %" PRIu64 " MiB KDF budget\n",
+   opt.socket_path.c_str(), opt.jobs, opt.budget / (UINT64_C(1) << 20));
+
+  std::atomic<bool> finished {false};
+  std::thread       reporter {&report, &finished};
+  {
+    // Jobs wait in this executor's queue for one of @opt.jobs slots, then for their KDF's memory.
+    Executor jobs      {opt.jobs};
+    // Reading a job may take a slow client up to a timeout; keep that off the accept loop.
+    // Destroyed first, so that it's done posting to @jobs before @jobs finishes.
+    Executor receivers {RECEIVE_THREADS};
+    uint64_t next_id   {1};
+    while (not stopping) {
+      pollfd pfd {server, POLLIN, 0};
+      if (poll(&pfd, 1, ACCEPT_POLL_MILLISECONDS) <= 0)
+        continue;
+      const int client {accept(server, nullptr, nullptr)};
+      if (client == -1)
+        continue;
+      local_set_timeouts(client, Daemon::TIMEOUT_MILLISECONDS);
+      if (not local_peer_is_self(client)) {
+        close(client);
+        continue;
+      }
+      auto rec {std::make_shared<JobRecord>()};
+      rec->id = next_id++;
+      rec->fd = client;
+      receivers.post([rec, &jobs]() { receive_job(rec, jobs); });
+    }
+    // Cancel everything, queued or running; the executor's destructor waits for the jobs to notice.
+    std::lock_guard<std::mutex> lock {active_mtx};
+    for (const Record_t& rec : active)
+      rec->cancel.cancel();
+  }
+  finished.store(true, std::memory_order_release);
+  reporter.join();
+  close(server);
+  unlink(opt.socket_path.c_str());
+  return EXIT_SUCCESS;
+}
+#endif // SSC_OS_UNIXLIKE
@@ -0,0 +1,263 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Executor.hh"
+#include "Resources.hh"
+#include "Trace.hh"
+// C++ STL
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <fstream>
+#include <memory>
+#include <string>
+#if defined(__linux__)
+ #include <sched.h>
+#endif
+using namespace fourcrypt;
+
+constexpr unsigned NO_CPU {UINT_MAX};
+
+/* Shared by the caller of parallelFor() and the workers helping it. Helpers may only get to run after
+ * the loop has finished, so they share ownership of it; they touch @body only after claiming an
+ * index, which can't happen once the caller has returned.
+ */
+struct ParallelLoop
+ {
+  const Executor::Body_f& body;
+  const uint64_t          count;
+  std::atomic<uint64_t>   next     {0};
+  std::mutex              mtx      {};
+  std::condition_variable cv       {};
+  uint64_t                finished {0};
+
+  ParallelLoop(const Executor::Body_f& b, uint64_t c)
+   : body{b}, count{c}
+   {}
+ };
+
+static void
+run_loop(ParallelLoop& loop)
+{
+  uint64_t done {0};
+  for (uint64_t i {loop.next.fetch_add(1)}; i < loop.count; i = loop.next.fetch_add(1)) {
+    loop.body(i);
+    ++done;
+  }
+  if (done == 0)
+    return;
+  std::lock_guard<std::mutex> lock {loop.mtx};
+  loop.finished += done;
+  if (loop.finished == loop.count)
+    loop.cv.notify_all();
+}
+
+#if defined(__linux__)
+/* Read a topology id from sysfs; 0 if it's unavailable. */
+static unsigned
+read_topology_id(const std::string& path)
+{
+  std::ifstream in {path};
+  unsigned      id {0};
+  if (not (in >> id))
+    return 0;
+  return id;
+}
+#endif
+
+/* Return the processors this process may run on, in the order @affinity assigns them to workers.
+ * Return nothing when the workers shouldn't be pinned.
+ */
+static std::vector<unsigned>
+pinning_order(Executor::Affinity affinity)
+{
+  std::vector<unsigned> cpus {};
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (affinity == Executor::Affinity::NONE or sched_getaffinity(0, sizeof(set), &set) != 0)
+    return cpus;
+  struct Place
+   {
+    unsigned cpu, package, core, core_rank, sibling;
+   };
+  std::vector<Place> places {};
+  for (unsigned cpu {0}; cpu < CPU_SETSIZE; ++cpu) {
+    if (not CPU_ISSET(cpu, &set))
+      continue;
+    const std::string topology {"/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/"};
+    places.push_back({cpu, read_topology_id(topology + "physical_package_id"), read_topology_id(topology + "core_id"), 0, 0});
+  }
+  // Compact order: hardware threads of a core are adjacent, and cores of a package are adjacent.
+  std::sort(places.begin(), places.end(), [](const Place& a, const Place& b) {
+    if (a.package != b.package)
+      return a.package < b.package;
+    if (a.core != b.core)
+      return a.core < b.core;
+    return a.cpu < b.cpu;
+  });
+  // Rank each core within its package, and each hardware thread within its core.
+  for (size_t i {1}; i < places.size(); ++i) {
+    const Place& prev {places[i - 1]};
+    Place&       p    {places[i]};
+    if (p.package != prev.package)
+      continue;
+    if (p.core == prev.core) {
+      p.core_rank = prev.core_rank;
+      p.sibling   = prev.sibling + 1;
+    }
+    else
+      p.core_rank = prev.core_rank + 1;
+  }
+  if (affinity == Executor::Affinity::SCATTER) {
+    // Deal out first hardware threads before siblings, taking one core of every package in turn.
+    std::stable_sort(places.begin(), places.end(), [](const Place& a, const Place& b) {
+      if (a.sibling != b.sibling)
+        return a.sibling < b.sibling;
+      return a.core_rank < b.core_rank;
+    });
+  }
+  for (const Place& p : places)
+    cpus.push_back(p.cpu);
+#else
+  (void)affinity;
+#endif
+  return cpus;
+}
+
+Executor::Executor(unsigned threads, Affinity affinity)
+{
+  if (threads == 0)
+    threads = static_cast<unsigned>(std::max<uint64_t>(Resources::detect().usableProcessors(), 1));
+  const std::vector<unsigned> cpus {pinning_order(affinity)};
+  this->workers.reserve(threads);
+  for (unsigned i {0}; i < threads; ++i)
+    this->workers.emplace_back(&Executor::work, this, cpus.empty() ? NO_CPU : cpus[i % cpus.size()]);
+}
+
+Executor::~Executor()
+{
+  {
+    std::lock_guard<std::mutex> lock {this->mtx};
+    this->stopping = true;
+  }
+  this->cv.notify_all();
+  for (std::thread& t : this->workers)
+    t.join();
+}
+
+void
+Executor::post(Task_t task)
+{
+  {
+    std::lock_guard<std::mutex> lock {this->mtx};
+    this->tasks.push_back(std::move(task));
+  }
+  this->cv.notify_one();
+}
+
+void
+Executor::parallelFor(uint64_t count, const Body_f& body)
+{
+  if (count < 2 or this->workers.empty()) {
+    for (uint64_t i {0}; i < count; ++i)
+      body(i);
+    return;
+  }
+  auto loop {std::make_shared<ParallelLoop>(body, count)};
+  const uint64_t helpers {std::min<uint64_t>(count - 1, this->workers.size())};
+  {
+    std::lock_guard<std::mutex> lock {this->mtx};
+    for (uint64_t i {0}; i < helpers; ++i)
+      this->tasks.push_back([loop]() { run_loop(*loop); });
+  }
+  for (uint64_t i {0}; i < helpers; ++i)
+    this->cv.notify_one();
+  run_loop(*loop);
+  std::unique_lock<std::mutex> lock {loop->mtx};
+  loop->cv.wait(lock, [&loop]() { return loop->finished == loop->count; });
+}
+
+unsigned
+Executor::threadCount(void) const
+{
+  return static_cast<unsigned>(this->workers.size());
+}
+
+static std::mutex         global_mtx      {};
+static bool               global_started  {false};
+static unsigned           global_threads  {0};
+static Executor::Affinity global_affinity {Executor::Affinity::NONE};
+
+bool
+Executor::configureGlobal(unsigned threads, Affinity affinity)
+{
+  std::lock_guard<std::mutex> lock {global_mtx};
+  if (global_started)
+    return false;
+  global_threads  = threads;
+  global_affinity = affinity;
+  return true;
+}
+
+Executor&
+Executor::global(void)
+{
+  static Executor executor {
+   []() -> unsigned {
+     std::lock_guard<std::mutex> lock {global_mtx};
+     global_started = true;
+     return global_threads;
+   }(),
+   global_affinity
+  };
+  return executor;
+}
+
+Executor&
+Executor::jobs(void)
+{
+  static Executor executor {};
+  return executor;
+}
+
+void
+Executor::work(unsigned cpu)
+{
+  Trace::setThreadName("executor");
+#if defined(__linux__)
+  if (cpu != NO_CPU) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+  }
+#else
+  (void)cpu;
+#endif
+  for (;;) {
+    Task_t task {};
+    {
+      std::unique_lock<std::mutex> lock {this->mtx};
+      this->cv.wait(lock, [this]() { return this->stopping or not this->tasks.empty(); });
+      if (this->tasks.empty())
+        return;
+      task = std::move(this->tasks.front());
+      this->tasks.pop_front();
+    }
+    task();
+  }
+}
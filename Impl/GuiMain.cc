@@ -15,15 +15,15 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "Gui.hh"
+#include "Executor.hh"
+#include "Resources.hh"
 #include "Util.hh"
 // GTK4
 #include <gio/gio.h>
 // C++ STL
 #include <algorithm>
-#include <chrono>
 #include <map>
 #include <string>
-#include <thread>
 #include <utility>
 // C++ C Lib
 #include <cstring>
@@ -45,7 +45,7 @@
 #endif
 using namespace fourcrypt;
 
-using Pod_t = Gui::Pod_t;
+using Job_t = Session::Job;
 constexpr int FOURCRYPT_IMG_WIDTH_ORIGINAL {300};
 constexpr int FOURCRYPT_IMG_WIDTH    {FOURCRYPT_IMG_WIDTH_ORIGINAL - 100};
 constexpr int FOURCRYPT_IMG_HEIGHT   {300};
@@ -78,8 +78,11 @@ static const std::map<SSC_CodeError_t, const char*> error_msg {
   {Core::ERROR_RESERVED_BYTES_USED       , "Reserved bytes of the input file were used!"},
   {Core::ERROR_OUTPUT_FILE_EXISTS        , "The output file already exists!"},
   {Core::ERROR_MAC_VALIDATION_FAILED     , "Failed to validate the Message Authentication Code. The input file may be corrupted or may have been maliciously modified!"},
-  {Core::ERROR_KDF_FAILED                , "Failed to compute cryptographic keys! For encryption try a lesser mode; for decryption lower the thread batch size!"},
-  {Core::ERROR_METADATA_VALIDATION_FAILED, "Failed to validate the input file's metadata!"}
+  {Core::ERROR_KDF_FAILED                , "Failed to compute cryptographic keys! Not enough memory is available, even when computing one KDF thread at a time. For encryption try a lesser mode!"},
+  {Core::ERROR_METADATA_VALIDATION_FAILED, "Failed to validate the input file's metadata!"},
+  {Core::ERROR_CANCELLED                 , "The operation was cancelled."},
+  {Core::ERROR_BUFFER_TOO_SMALL          , "The output buffer is too small!"},
+  {Core::ERROR_INVALID_PADDING           , "The requested padding is smaller than the input!"}
 };
 
 static bool
@@ -155,9 +158,8 @@ Gui::getResourcePath(void)
  }
 
 Gui::Gui(Core* param_core, int param_argc, char** param_argv)
-: mCore{param_core}, mArgc{param_argc}, mArgv{param_argv}, mNumberProcessors{SSC_getNumberProcessors()}
+: mCore{param_core}, mArgc{param_argc}, mArgv{param_argv}, mNumberProcessors{static_cast<int>(Resources::detect().usableProcessors())}
  {
-  mPod = mCore->getPod();
   gtk_init();
 
   mFileDialog  = gtk_file_dialog_new();
@@ -273,19 +275,44 @@ using PadMode  = Core::PadMode;
 using InOutDir = Core::InOutDir;
 using ErrType  = Core::ErrType;
 
+void
+Gui::refreshProgressBar(void)
+ {
+  GtkProgressBar*      pb {GTK_PROGRESS_BAR(mProgressBar)};
+  const Core::Progress p  {mCore->getProgress()->load()};
+  if (p.phase == Core::Phase::KDF) {
+    // Without a calibration to predict the KDF's duration by, just show that it's busy.
+    const double kdf {mCore->getKdfProgress()->estimatedFraction()};
+    if (kdf < 0.0)
+      gtk_progress_bar_pulse(pb);
+    else
+      gtk_progress_bar_set_fraction(pb, kdf);
+  }
+  else if (p.bytes_total != 0)
+    gtk_progress_bar_set_fraction(pb, static_cast<double>(p.bytes_done) / static_cast<double>(p.bytes_total));
+ }
+
+void
+Gui::startProgressPolling(void)
+ {
+  gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(mProgressBar), 0.0);
+  mProgressSource = g_timeout_add(
+   PROGRESS_POLL_MILLISECONDS,
+   static_cast<GSourceFunc>([](void* vgui) -> gboolean
+    {
+     static_cast<Gui*>(vgui)->refreshProgressBar();
+     return G_SOURCE_CONTINUE;
+    }),
+   this);
+ }
+
 void
 Gui::updateProgressCallback(void* v_gui)
  {
   g_idle_add(
    static_cast<GSourceFunc>([](void* vgui) -> gboolean
     {
-     Gui*            gui {static_cast<Gui*>(vgui)};
-     GtkProgressBar* pb  {GTK_PROGRESS_BAR(gui->mProgressBar)};
-     double old_fraction {gtk_progress_bar_get_fraction(pb)};
-     double new_fraction {old_fraction + PROGRESS_PULSE_STEP};
-     if (new_fraction > 1.0)
-       new_fraction = 1.0;
-     gtk_progress_bar_set_fraction(pb, new_fraction);
+     static_cast<Gui*>(vgui)->refreshProgressBar();
      return G_SOURCE_REMOVE;
     }),
    v_gui);
@@ -295,6 +322,11 @@ gboolean
 Gui::endOperation(void* vgui)
  {
   Gui* g {static_cast<Gui*>(vgui)};
+  if (g->mProgressSource != 0)
+   {
+    g_source_remove(g->mProgressSource);
+    g->mProgressSource = 0;
+   }
   gtk_widget_set_visible(g->mProgressBox, FALSE);
   gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(g->mProgressBar), 0.0);
   g->mOperationIsOngoingMtx.lock();
@@ -304,23 +336,7 @@ Gui::endOperation(void* vgui)
  }
 
 gboolean
-Gui::makeStatusVisible(void* vgui)
- {
-  Gui* g {static_cast<Gui*>(vgui)};
-  gtk_widget_set_visible(g->mStatusBox, TRUE);
-  return G_SOURCE_REMOVE;
- }
-
-gboolean
-Gui::makeStatusInvisible(void* vgui)
- {
-  Gui* g {static_cast<Gui*>(vgui)};
-  gtk_widget_set_visible(g->mStatusBox, FALSE);
-  return G_SOURCE_REMOVE;
- }
-
-void
-Gui::statusThread(void* vgui)
+Gui::startStatusBlinking(void* vgui)
  {
   Gui* gui {static_cast<Gui*>(vgui)};
   gui->mStatusIsBlinkingMtx.lock();
@@ -328,20 +344,36 @@ Gui::statusThread(void* vgui)
    {
     gui->mStatusIsBlinking = true;
     gui->mStatusIsBlinkingMtx.unlock();
-    bool is_blinking {true};
-    while (is_blinking)
-     {
-      g_idle_add(&makeStatusVisible, gui);
-      std::this_thread::sleep_for(std::chrono::milliseconds(750));
-      g_idle_add(&makeStatusInvisible, gui);
-      std::this_thread::sleep_for(std::chrono::milliseconds(750));
-      gui->mStatusIsBlinkingMtx.lock();
-      is_blinking = gui->mStatusIsBlinking;
-      gui->mStatusIsBlinkingMtx.unlock();
-     }
+    gtk_widget_set_visible(gui->mStatusBox, TRUE);
+    // A blink dismissed moments ago may not have noticed yet.
+    if (gui->mStatusBlinkSource != 0)
+      g_source_remove(gui->mStatusBlinkSource);
+    gui->mStatusBlinkSource = g_timeout_add(STATUS_BLINK_MILLISECONDS, &blinkStatus, gui);
    }
   else
     gui->mStatusIsBlinkingMtx.unlock();
+  return G_SOURCE_REMOVE;
+ }
+
+gboolean
+Gui::blinkStatus(void* vgui)
+ {
+  Gui* gui {static_cast<Gui*>(vgui)};
+  bool is_blinking;
+  gui->mStatusIsBlinkingMtx.lock();
+  is_blinking = gui->mStatusIsBlinking;
+  gui->mStatusIsBlinkingMtx.unlock();
+  // Always finish a blink invisible.
+  if (not is_blinking or gtk_widget_get_visible(gui->mStatusBox))
+   {
+    gtk_widget_set_visible(gui->mStatusBox, FALSE);
+    if (is_blinking)
+      return G_SOURCE_CONTINUE;
+    gui->mStatusBlinkSource = 0;
+    return G_SOURCE_REMOVE;
+   }
+  gtk_widget_set_visible(gui->mStatusBox, TRUE);
+  return G_SOURCE_CONTINUE;
  }
 
 void
@@ -349,9 +381,8 @@ Gui::encryptThread(
  Core::StatusCallback_f* status_callback,
  void*                   status_callback_data)
  {
-  Gui*   gui  {static_cast<Gui*>(status_callback_data)};
-  Core*  core {gui->mCore};
-  Pod_t* pod  {gui->mPod};
+  Gui*   gui {static_cast<Gui*>(status_callback_data)};
+  Job_t* job {&gui->mJob};
   {
     std::lock_guard lg {gui->mOperationMtx};
 
@@ -360,7 +391,7 @@ Gui::encryptThread(
      {
       // Phi.
       if (gtk_check_button_get_active(GTK_CHECK_BUTTON(gui->mEncryptParamPhiCheckbutton)))
-        pod->flags |= Core::ENABLE_PHI;
+        job->flags |= Core::ENABLE_PHI;
       // Memory Usage.
       const auto mem_usage_idx {gtk_drop_down_get_selected(GTK_DROP_DOWN(gui->mEncryptParamMemoryDropdown))};
       if (mem_usage_idx != GTK_INVALID_LIST_POSITION)
@@ -369,8 +400,8 @@ Gui::encryptThread(
         if (mem_usage != nullptr)
          {
           uint8_t mem {parse_memory(mem_usage, std::strlen(mem_usage))};
-          pod->memory_low  = mem;
-          pod->memory_high = mem;
+          job->memory_low  = mem;
+          job->memory_high = mem;
          }
        }
       // Iterations.
@@ -378,37 +409,36 @@ Gui::encryptThread(
       const char* ebuf_cstr    {gtk_entry_buffer_get_text(ebuf)};
       const uint8_t iterations {parse_iterations(ebuf_cstr, std::strlen(ebuf_cstr))};
       if (iterations > 0)
-        pod->iterations = iterations;
+        job->iterations = iterations;
       // Threads Count.
       ebuf             = gtk_text_get_buffer(GTK_TEXT(gui->mEncryptParamThreadText));
       ebuf_cstr        = gtk_entry_buffer_get_text(ebuf);
       uint64_t threads {parse_integer(ebuf_cstr, std::strlen(ebuf_cstr))};
-      pod->thread_count = threads;
+      job->thread_count = threads;
       // Thread Batch Size.
       ebuf      = gtk_text_get_buffer(GTK_TEXT(gui->mEncryptParamBatchSizeText));
       ebuf_cstr = gtk_entry_buffer_get_text(ebuf);
       uint64_t batch_size {parse_integer(ebuf_cstr, std::strlen(ebuf_cstr))};
-      if (batch_size <= pod->thread_count)
-        pod->thread_batch_size = batch_size;
+      if (batch_size <= job->thread_count)
+        job->thread_batch_size = batch_size;
      }
     else if (gtk_check_button_get_active(GTK_CHECK_BUTTON(gui->mStrengthStrongCheckbutton)))
      {
-      Pod_t::set_strong(*pod);
+      job->preset = Session::Preset::STRONG;
      }
     else if (gtk_check_button_get_active(GTK_CHECK_BUTTON(gui->mStrengthStandardCheckbutton)))
      {
-      Pod_t::set_normal(*pod); //TODO: Rename normal to standard or vice-versa.
+      job->preset = Session::Preset::NORMAL; //TODO: Rename normal to standard or vice-versa.
      }
     else // (Assume fast parameter selection.)
      {
-      Pod_t::set_fast(*pod);
+      job->preset = Session::Preset::FAST;
      }
 
-    gui->mOperationData.code_error = core->encrypt(
-     &gui->mOperationData.error_type,
-     &gui->mOperationData.in_out_dir,
-     status_callback,
-     gui);
+    const Session::Result res {gui->mSession.run(*job, *gui->mCore, status_callback, gui)};
+    // Don't keep the password around until the next operation.
+    job->clearPassword();
+    gui->mOperationData = {res.code, res.type, res.dir};
     if (gui->mOperationData.code_error == 0)
      {
       g_idle_add([](void* vgui) -> gboolean
@@ -430,15 +460,9 @@ Gui::encryptThread(
        },
        gui);
      }
-    Pod_t::del(*pod);
-    Pod_t::init(*pod);
-    TSC_CSPRNG_init(&pod->rng);
 
-    std::thread th {&statusThread, gui};
-    th.detach();
-
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    g_idle_add(&endOperation, gui);
+    g_idle_add(&startStatusBlinking, gui);
+    g_timeout_add_seconds(1, &endOperation, gui);
   }
  }
 
@@ -450,12 +474,12 @@ Gui::encrypt(void)
    {
     mOperationIsOngoing = true;
     mOperationIsOngoingMtx.unlock();
-    mPod->execute_mode = ExeMode::ENCRYPT;
-    Pod_t::touchup(*mPod);
+    mJob.mode = ExeMode::ENCRYPT;
+    mCore->getCancelToken()->clear();
     gtk_widget_set_visible(mProgressBox, TRUE);
+    startProgressPolling();
 
-    std::thread th {&encryptThread, &updateProgressCallback, this};
-    th.detach();
+    Executor::jobs().post([this]() { encryptThread(&updateProgressCallback, this); });
    }
   else
     mOperationIsOngoingMtx.unlock();
@@ -466,19 +490,13 @@ Gui::decryptThread(
  Core::StatusCallback_f* status_callback,
  void*                   status_callback_data)
  {
-  Gui*   gui  {static_cast<Gui*>(status_callback_data)};
-  Core*  core {gui->mCore};
-  Pod_t* pod  {gui->mPod};
+  Gui* gui {static_cast<Gui*>(status_callback_data)};
   {
     std::lock_guard lg {gui->mOperationMtx};
-    gui->mOperationData.code_error = core->decrypt(
-     &gui->mOperationData.error_type,
-     &gui->mOperationData.in_out_dir,
-     status_callback,
-     gui);
-    Pod_t::del(*pod);
-    Pod_t::init(*pod);
-    TSC_CSPRNG_init(&pod->rng);
+    const Session::Result res {gui->mSession.run(gui->mJob, *gui->mCore, status_callback, gui)};
+    // Don't keep the password around until the next operation.
+    gui->mJob.clearPassword();
+    gui->mOperationData = {res.code, res.type, res.dir};
     if (gui->mOperationData.code_error == 0)
      {
       g_idle_add([](void* vgui) -> gboolean
@@ -501,11 +519,8 @@ Gui::decryptThread(
        gui);
      }
 
-    std::thread th {&statusThread, gui};
-    th.detach();
-
-    std::this_thread::sleep_for(std::chrono::seconds(1));
-    g_idle_add(&endOperation, gui);
+    g_idle_add(&startStatusBlinking, gui);
+    g_timeout_add_seconds(1, &endOperation, gui);
   }
  }
 
@@ -517,44 +532,40 @@ Gui::decrypt(void)
    {
     mOperationIsOngoing = true;
     mOperationIsOngoingMtx.unlock();
-    mPod->execute_mode = ExeMode::DECRYPT;
+    mJob.mode = ExeMode::DECRYPT;
+    mCore->getCancelToken()->clear();
     gtk_widget_set_visible(mProgressBox, TRUE);
+    startProgressPolling();
 
-    std::thread th {&decryptThread, &updateProgressCallback, this};
-    th.detach();
+    Executor::jobs().post([this]() { decryptThread(&updateProgressCallback, this); });
    }
   else
     mOperationIsOngoingMtx.unlock();
  }
 
+void
+Gui::onCancelButtonClicked(GtkWidget* button, void* self)
+ {
+  // The operation thread notices within a few milliseconds, removes its partial output and reports ERROR_CANCELLED.
+  static_cast<Gui*>(self)->mCore->getCancelToken()->cancel();
+ }
+
 void
 Gui::onStartButtonClicked(GtkWidget* button, void* self)
  {
-  Gui*   gui {static_cast<Gui*>(self)};
-  Pod_t* pod {gui->mPod};
+  Gui* gui {static_cast<Gui*>(self)};
 
   std::puts("Start button was pushed.");
   if (not gui->verifyInputs())
     return;
 
-  // Reset the POD if it's been initialized.
-  if (pod->input_filename)
-   {
-    Pod_t::del(*pod);
-    Pod_t::init(*pod);
-    TSC_CSPRNG_init(&pod->rng);
-   }
-
+  // Forget the parameters of the previous job, if any.
+  gui->mJob = Job_t{};
   if (not gui->getPassword())
     return;
 
-  pod->input_filename = new char [gui->mInputFilepath.size() + 1];
-  memcpy(pod->input_filename, gui->mInputFilepath.c_str(), gui->mInputFilepath.size() + 1);
-  pod->output_filename = new char [gui->mOutputFilepath.size() + 1];
-  memcpy(pod->output_filename, gui->mOutputFilepath.c_str(), gui->mOutputFilepath.size() + 1);
-
-  pod->input_filename_size  = gui->mInputFilepath.size();
-  pod->output_filename_size = gui->mOutputFilepath.size();
+  gui->mJob.input  = gui->mInputFilepath;
+  gui->mJob.output = gui->mOutputFilepath;
 
   switch (gui->mMode)
    {
@@ -754,7 +765,7 @@ Gui::getPassword(void)
     return false;
    }
   bool equal {(pw_0_len == pw_1_len) and (not std::strcmp(pw_0, pw_1))};
-  memset(mPod->password_buffer, 0, sizeof(mPod->password_buffer));
+  mJob.clearPassword();
 
   if (pw_0_len == 0)
     return false;
@@ -764,12 +775,10 @@ Gui::getPassword(void)
       // ENCRYPT mode requires that we get the same password input at least twice.
       if (not equal)
         return false;
-      memcpy(mPod->password_buffer, pw_0, pw_0_len);
-      mPod->password_size = pw_0_len;
+      mJob.setPassword(pw_0, pw_0_len);
       break;
     case Mode::DECRYPT:
-      memcpy(mPod->password_buffer, pw_0, pw_0_len);
-      mPod->password_size = pw_0_len;
+      mJob.setPassword(pw_0, pw_0_len);
       break;
    }
   return true;
@@ -1244,7 +1253,10 @@ Gui::initProgressBox(void)
   mProgressBar = gtk_progress_bar_new();
   gtk_widget_set_hexpand(mProgressBar, TRUE);
   gtk_box_append(GTK_BOX(mProgressBox), mProgressBar);
-  // Set the pulse of progress for each step of progress
+  mCancelButton = gtk_button_new_with_label("Cancel");
+  g_signal_connect(mCancelButton, "clicked", G_CALLBACK(onCancelButtonClicked), this);
+  gtk_box_append(GTK_BOX(mProgressBox), mCancelButton);
+  // Set how far the bar moves with each pulse while no byte counts are available.
   gtk_progress_bar_set_pulse_step(GTK_PROGRESS_BAR(mProgressBar), PROGRESS_PULSE_STEP);
   gtk_widget_set_hexpand(mProgressBox, TRUE);
   gtk_widget_set_vexpand(mProgressBox, TRUE);
@@ -0,0 +1,207 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "LocalSocket.hh"
+// SSC
+#include <SSC/Error.h>
+// C++ C Lib
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <sys/socket.h>
+ #include <sys/stat.h>
+ #include <sys/time.h>
+ #include <sys/un.h>
+ #include <unistd.h>
+#endif
+using namespace fourcrypt;
+
+#if defined(SSC_OS_UNIXLIKE) && defined(MSG_NOSIGNAL)
+ #define SEND_FLAGS_ MSG_NOSIGNAL
+#else
+ #define SEND_FLAGS_ 0
+#endif
+
+#if defined(SSC_OS_UNIXLIKE)
+/* Fill @addr with @path. Return false if it doesn't fit. */
+static bool
+make_address(sockaddr_un& addr, const std::string& path)
+{
+  if (path.empty() or path.size() >= sizeof(addr.sun_path))
+    return false;
+  addr = sockaddr_un{};
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+/* Create the directory of a default socket path, which must be private to us. */
+static void
+prepare_directory(const std::string& path)
+{
+  const std::string dir {path.substr(0, path.find_last_of('/'))};
+  if (dir.rfind("/tmp/4crypt-", 0) != 0)
+    return;
+  if (mkdir(dir.c_str(), 0700) != 0 and errno != EEXIST)
+    SSC_errx("Error: Failed to create %s!\n", dir.c_str());
+  struct stat st {};
+  SSC_assertMsg(
+   lstat(dir.c_str(), &st) == 0 and S_ISDIR(st.st_mode) and st.st_uid == geteuid() and (st.st_mode & 077) == 0,
+   "Error: %s must be a directory private to this user!\n", dir.c_str());
+}
+#endif
+
+std::string
+fourcrypt::local_socket_path(const char* name)
+{
+  if (const char* xdg {std::getenv("XDG_RUNTIME_DIR")}; xdg != nullptr and xdg[0] != '\0')
+    return std::string{xdg} + "/4crypt-" + name + ".sock";
+#if defined(SSC_OS_UNIXLIKE)
+  return "/tmp/4crypt-" + std::to_string(getuid()) + "/" + name + ".sock";
+#else
+  return {};
+#endif
+}
+
+int
+fourcrypt::local_connect(const std::string& path, unsigned timeout_ms)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  sockaddr_un addr;
+  if (not make_address(addr, path))
+    return -1;
+  const int fd {socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (fd == -1)
+    return -1;
+  local_set_timeouts(fd, timeout_ms);
+  if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 or not local_peer_is_self(fd)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  (void)path;
+  (void)timeout_ms;
+  return -1;
+#endif
+}
+
+int
+fourcrypt::local_listen(const std::string& path)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  sockaddr_un addr;
+  SSC_assertMsg(make_address(addr, path), "Error: Invalid socket path '%s'!\n", path.c_str());
+  prepare_directory(path);
+  // Refuse to displace a live listener, but replace the socket of a dead one.
+  if (const int probe {socket(AF_UNIX, SOCK_STREAM, 0)}; probe != -1) {
+    const bool live {connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0};
+    close(probe);
+    SSC_assertMsg(not live, "Error: Something is already listening on %s!\n", path.c_str());
+  }
+  unlink(path.c_str());
+  const int fd {socket(AF_UNIX, SOCK_STREAM, 0)};
+  SSC_assertMsg(fd != -1, "Error: Failed to create a socket!\n");
+  const mode_t old_umask {umask(077)};
+  const int    bound     {bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))};
+  umask(old_umask);
+  SSC_assertMsg(bound == 0, "Error: Failed to bind %s: %s\n", path.c_str(), std::strerror(errno));
+  SSC_assertMsg(listen(fd, 16) == 0, "Error: Failed to listen on %s!\n", path.c_str());
+  return fd;
+#else
+  SSC_errx("Error: Unix domain sockets are unsupported on this system!\n");
+  return -1;
+#endif
+}
+
+void
+fourcrypt::local_set_timeouts(int fd, unsigned timeout_ms)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  timeval tv {};
+  tv.tv_sec  = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#else
+  (void)fd;
+  (void)timeout_ms;
+#endif
+}
+
+bool
+fourcrypt::local_peer_is_self(int fd)
+{
+#if defined(SSC_OS_UNIXLIKE)
+ #if defined(SO_PEERCRED)
+  struct ucred cred {};
+  socklen_t    len {sizeof(cred)};
+  if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    return false;
+  return cred.uid == geteuid();
+ #else
+  uid_t uid;
+  gid_t gid;
+  if (getpeereid(fd, &uid, &gid) != 0)
+    return false;
+  return uid == geteuid();
+ #endif
+#else
+  (void)fd;
+  return false;
+#endif
+}
+
+bool
+fourcrypt::local_send_all(int fd, const void* buf, size_t size)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  const uint8_t* p {static_cast<const uint8_t*>(buf)};
+  while (size != 0) {
+    const ssize_t n {send(fd, p, size, SEND_FLAGS_)};
+    if (n <= 0)
+      return false;
+    p    += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+#else
+  (void)fd;
+  (void)buf;
+  return size == 0;
+#endif
+}
+
+bool
+fourcrypt::local_recv_all(int fd, void* buf, size_t size)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  uint8_t* p {static_cast<uint8_t*>(buf)};
+  while (size != 0) {
+    const ssize_t n {recv(fd, p, size, 0)};
+    if (n <= 0)
+      return false;
+    p    += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+#else
+  (void)fd;
+  (void)buf;
+  return size == 0;
+#endif
+}
@@ -0,0 +1,71 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "MemoryBudget.hh"
+// C++ STL
+#include <algorithm>
+#include <chrono>
+using namespace fourcrypt;
+
+MemoryBudget::MemoryBudget(uint64_t bytes)
+: total{bytes}
+{}
+
+bool
+MemoryBudget::acquire(uint64_t bytes, const Core::CancelToken* cancel)
+{
+  std::unique_lock<std::mutex> lock {this->mtx};
+  const uint64_t ticket {this->next_ticket++};
+  this->waiting.push_back(ticket);
+  for (;;) {
+    if (this->waiting.front() == ticket and (this->in_use == 0 or this->in_use + bytes <= this->total))
+      break;
+    if (cancel != nullptr and cancel->isCancelled()) {
+      this->waiting.remove(ticket);
+      // The next reservation in line may fit now.
+      this->cv.notify_all();
+      return false;
+    }
+    this->cv.wait_for(lock, std::chrono::milliseconds(Core::CANCEL_POLL_MILLISECONDS));
+  }
+  this->waiting.pop_front();
+  this->in_use += bytes;
+  this->cv.notify_all();
+  return true;
+}
+
+void
+MemoryBudget::release(uint64_t bytes)
+{
+  {
+    std::lock_guard<std::mutex> lock {this->mtx};
+    this->in_use -= std::min(bytes, this->in_use);
+  }
+  this->cv.notify_all();
+}
+
+uint64_t
+MemoryBudget::capacity(void) const
+{
+  return this->total;
+}
+
+uint64_t
+MemoryBudget::reserved(void) const
+{
+  std::lock_guard<std::mutex> lock {this->mtx};
+  return this->in_use;
+}
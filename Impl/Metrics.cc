@@ -0,0 +1,271 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Metrics.hh"
+// C++ STL
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+// C++ C Lib
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <fcntl.h>
+ #include <sys/file.h>
+ #include <unistd.h>
+#endif
+using namespace fourcrypt;
+
+std::atomic<bool> Metrics::is_enabled {false};
+
+constexpr int NUM_COUNTERS {static_cast<int>(Metrics::Counter::COUNT)};
+constexpr int NUM_PHASES   {static_cast<int>(Core::Phase::COUNT)};
+
+// Counters updated by different threads at once mustn't share a cache line.
+struct alignas(64) MetricCell
+ {
+  std::atomic<uint64_t> value {0};
+ };
+
+struct alignas(64) MetricHistogram
+ {
+  std::array<std::atomic<uint64_t>, Metrics::NUM_BUCKETS> buckets {}; // Not cumulative; summed on export.
+  std::atomic<uint64_t>                                    count       {0};
+  std::atomic<uint64_t>                                    nanoseconds {0};
+ };
+
+struct CounterInfo
+ {
+  const char* family;
+  const char* labels;
+  const char* help;
+ };
+
+// Indexed by Metrics::Counter. Counters of the same family must be adjacent.
+static constexpr CounterInfo counter_info[] {
+  {"fourcrypt_bytes_encrypted_total", "",                  "Plaintext bytes encrypted."},
+  {"fourcrypt_bytes_decrypted_total", "",                  "Plaintext bytes decrypted."},
+  {"fourcrypt_files_processed_total", "{mode=\"encrypt\"}", "Files encrypted, decrypted or verified successfully."},
+  {"fourcrypt_files_processed_total", "{mode=\"decrypt\"}", "Files encrypted, decrypted or verified successfully."},
+  {"fourcrypt_files_processed_total", "{mode=\"verify\"}",  "Files encrypted, decrypted or verified successfully."},
+  {"fourcrypt_mac_failures_total",    "",                  "MACs that didn't match, due to a wrong password or a corrupted file."},
+  {"fourcrypt_kdf_invocations_total", "",                  "Key derivations computed."},
+  {"fourcrypt_kdf_cache_hits_total",  "",                  "Key derivations answered by 4crypt-agent instead of being computed."},
+};
+static_assert(sizeof(counter_info) / sizeof(counter_info[0]) == NUM_COUNTERS);
+
+static std::array<MetricCell, NUM_COUNTERS>    counters {};
+static std::array<MetricHistogram, NUM_PHASES> phase_histograms {};
+static MetricHistogram                         kdf_histogram {};
+
+// Never destroyed, so that the periodic exporter may still run while static objects are destroyed at exit.
+struct ExportState
+ {
+  std::mutex  mtx        {};
+  std::string path       {};
+  bool        accumulate {true};
+  std::unordered_map<std::string, double> exported {}; // What this process already added to @path.
+ };
+static ExportState* const export_state {new ExportState{}};
+
+struct MetricSample
+ {
+  std::string series;
+  double      value;
+ };
+
+struct MetricFamily
+ {
+  std::string               name;
+  const char*               help;
+  const char*               type;
+  std::vector<MetricSample> samples {};
+ };
+
+static void
+observe(MetricHistogram& h, uint64_t nanoseconds)
+{
+  const double seconds {static_cast<double>(nanoseconds) / 1e9};
+  int i {0};
+  while (i < Metrics::NUM_BUCKETS - 1 and seconds > Metrics::BUCKET_SECONDS[i])
+    ++i;
+  h.buckets[i].fetch_add(1, std::memory_order_relaxed);
+  h.count.fetch_add(1, std::memory_order_relaxed);
+  h.nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+/* Append the series of @h to @fam, each with the label @label (e.g. phase="kdf") if not empty. */
+static void
+collect_histogram(MetricFamily& fam, const MetricHistogram& h, const std::string& label)
+{
+  const std::string sep {label.empty() ? "" : ","};
+  uint64_t cumulative {0};
+  for (int i {0}; i < Metrics::NUM_BUCKETS; ++i) {
+    cumulative += h.buckets[i].load(std::memory_order_relaxed);
+    char le [32];
+    if (i < Metrics::NUM_BUCKETS - 1)
+      std::snprintf(le, sizeof(le), "%g", Metrics::BUCKET_SECONDS[i]);
+    else
+      std::snprintf(le, sizeof(le), "+Inf");
+    fam.samples.push_back({fam.name + "_bucket{" + label + sep + "le=\"" + le + "\"}", static_cast<double>(cumulative)});
+  }
+  const std::string labels {label.empty() ? "" : "{" + label + "}"};
+  fam.samples.push_back({fam.name + "_sum" + labels, static_cast<double>(h.nanoseconds.load(std::memory_order_relaxed)) / 1e9});
+  fam.samples.push_back({fam.name + "_count" + labels, static_cast<double>(h.count.load(std::memory_order_relaxed))});
+}
+
+static std::vector<MetricFamily>
+collect(void)
+{
+  std::vector<MetricFamily> families {};
+  for (int i {0}; i < NUM_COUNTERS; ++i) {
+    const CounterInfo& info {counter_info[i]};
+    if (families.empty() or families.back().name != info.family)
+      families.push_back({info.family, info.help, "counter"});
+    families.back().samples.push_back(
+     {std::string{info.family} + info.labels, static_cast<double>(counters[i].value.load(std::memory_order_relaxed))});
+  }
+  families.push_back({"fourcrypt_kdf_seconds", "Time spent computing key derivations.", "histogram"});
+  collect_histogram(families.back(), kdf_histogram, "");
+  families.push_back({"fourcrypt_phase_seconds", "Time spent in each phase of an operation.", "histogram"});
+  for (int i {0}; i < NUM_PHASES; ++i) {
+    const std::string label {std::string{"phase=\""} + Core::phaseName(static_cast<Core::Phase>(i)) + "\""};
+    collect_histogram(families.back(), phase_histograms[i], label);
+  }
+  return families;
+}
+
+/* Read every sample of the exposition at @path, if there is one. */
+static std::unordered_map<std::string, double>
+read_samples(const std::string& path)
+{
+  std::unordered_map<std::string, double> samples {};
+  std::ifstream in {path};
+  std::string   line {};
+  while (std::getline(in, line)) {
+    const size_t space {line.rfind(' ')};
+    if (line.empty() or line[0] == '#' or space == std::string::npos)
+      continue;
+    samples[line.substr(0, space)] = std::strtod(line.c_str() + space + 1, nullptr);
+  }
+  return samples;
+}
+
+/* Write @families to @path atomically, since the textfile collector may read it at any moment. */
+static bool
+write_families(const std::string& path, const std::vector<MetricFamily>& families)
+{
+  const std::string tmp {path + ".tmp"};
+  std::FILE* f {std::fopen(tmp.c_str(), "w")};
+  if (f == nullptr)
+    return false;
+  for (const MetricFamily& fam : families) {
+    std::fprintf(f, "# HELP %s %s\n# TYPE %s %s\n", fam.name.c_str(), fam.help, fam.name.c_str(), fam.type);
+    for (const MetricSample& s : fam.samples) {
+      // Counts are exact integers; sums of seconds don't need more than nanosecond precision.
+      if (s.value == std::floor(s.value) and s.value < 0x1p53)
+        std::fprintf(f, "%s %.0f\n", s.series.c_str(), s.value);
+      else
+        std::fprintf(f, "%s %.9f\n", s.series.c_str(), s.value);
+    }
+  }
+  if (std::fclose(f) != 0 or std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+void Metrics::start(const std::string& path, unsigned interval_seconds)
+{
+  {
+    std::lock_guard lg {export_state->mtx};
+    export_state->path       = path;
+    export_state->accumulate = (interval_seconds == 0);
+  }
+  if (not is_enabled.exchange(true, std::memory_order_release)) {
+    // Export on every exit path, including SSC_errx().
+    std::atexit([]() { Metrics::dump(); });
+    if (interval_seconds != 0) {
+      std::thread{[interval_seconds]() {
+        for (;;) {
+          std::this_thread::sleep_for(std::chrono::seconds(interval_seconds));
+          Metrics::dump();
+        }
+      }}.detach();
+    }
+  }
+}
+
+void Metrics::add(Counter counter, uint64_t n)
+{
+  if (Metrics::enabled())
+    counters[static_cast<int>(counter)].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void Metrics::observePhase(Core::Phase phase, uint64_t nanoseconds)
+{
+  if (Metrics::enabled())
+    observe(phase_histograms[static_cast<int>(phase)], nanoseconds);
+}
+
+void Metrics::observeKdf(uint64_t nanoseconds)
+{
+  if (Metrics::enabled())
+    observe(kdf_histogram, nanoseconds);
+}
+
+bool Metrics::dump(void)
+{
+  std::lock_guard lg {export_state->mtx};
+  const std::string& path {export_state->path};
+  if (path.empty())
+    return false;
+  std::vector<MetricFamily> families {collect()};
+  if (not export_state->accumulate)
+    return write_families(path, families);
+  // Other runs of the batch may be exporting into the same file right now.
+ #if defined(SSC_OS_UNIXLIKE)
+  const int lock_fd {open((path + ".lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)};
+  if (lock_fd != -1)
+    flock(lock_fd, LOCK_EX);
+ #endif
+  // Add only what this process hasn't added to the file yet, in case dump() is called more than once.
+  const auto previous {read_samples(path)};
+  std::unordered_map<std::string, double> totals {};
+  for (MetricFamily& fam : families) {
+    for (MetricSample& s : fam.samples) {
+      totals[s.series] = s.value;
+      s.value -= export_state->exported[s.series];
+      if (auto it {previous.find(s.series)}; it != previous.end())
+        s.value += it->second;
+    }
+  }
+  const bool ok {write_families(path, families)};
+  if (ok)
+    export_state->exported = std::move(totals);
+ #if defined(SSC_OS_UNIXLIKE)
+  if (lock_fd != -1)
+    close(lock_fd); // Releases the lock.
+ #endif
+  return ok;
+}
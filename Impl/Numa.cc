@@ -0,0 +1,114 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Numa.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+#if defined(__linux__)
+ #include <unistd.h>
+ #include <sys/syscall.h>
+ #define HAS_MEMPOLICY_ 1
+ // From <linux/mempolicy.h>, which is not present on every system.
+ #define MPOL_DEFAULT_    0
+ #define MPOL_INTERLEAVE_ 3
+#else
+ #define HAS_MEMPOLICY_ 0
+#endif
+
+using namespace fourcrypt;
+
+/* Parse a sysfs node list such as "0", "0-1" or "0,2-3" into a bitmask.
+ * Nodes beyond 63 are ignored. */
+static uint64_t
+parse_node_list(const char* str)
+{
+  uint64_t mask {0};
+  while (*str != '\0' && *str != '\n') {
+    if (not std::isdigit(static_cast<unsigned char>(*str)))
+      return 0;
+    char* end;
+    unsigned long first {std::strtoul(str, &end, 10)};
+    unsigned long last  {first};
+    str = end;
+    if (*str == '-') {
+      last = std::strtoul(str + 1, &end, 10);
+      str = end;
+    }
+    for (unsigned long n {first}; n <= last && n < 64; ++n)
+      mask |= static_cast<uint64_t>(1) << n;
+    if (*str == ',')
+      ++str;
+  }
+  return mask;
+}
+
+uint64_t
+fourcrypt::numa_online_nodes(void)
+{
+#if HAS_MEMPOLICY_
+  FILE* f {std::fopen("/sys/devices/system/node/online", "r")};
+  if (f == nullptr)
+    return 0;
+  char buf [256] {};
+  const bool ok {std::fgets(buf, sizeof(buf), f) != nullptr};
+  std::fclose(f);
+  if (not ok)
+    return 0;
+  return parse_node_list(buf);
+#else
+  return 0;
+#endif
+}
+
+bool
+fourcrypt::numa_interleave_begin(NumaPolicy* saved)
+{
+#if HAS_MEMPOLICY_
+  // Hosts with more than 64 possible nodes fail here, and are left alone.
+  NumaPolicy current {};
+  if (syscall(SYS_get_mempolicy, &current.mode, &current.nodes, sizeof(current.nodes) * 8, nullptr, 0) != 0)
+    return false;
+  // Whoever chose another policy knows better than we do.
+  if (current.mode != MPOL_DEFAULT_)
+    return false;
+  unsigned long nodes {static_cast<unsigned long>(numa_online_nodes())};
+  if (__builtin_popcountl(nodes) < 2)
+    return false;
+  if (syscall(SYS_set_mempolicy, MPOL_INTERLEAVE_, &nodes, sizeof(nodes) * 8 + 1) != 0)
+    return false;
+  *saved = current;
+  return true;
+#else
+  (void)saved;
+  return false;
+#endif
+}
+
+void
+fourcrypt::numa_interleave_end(const NumaPolicy& saved)
+{
+#if HAS_MEMPOLICY_
+  if (saved.mode == MPOL_DEFAULT_)
+    syscall(SYS_set_mempolicy, MPOL_DEFAULT_, nullptr, 0);
+  else
+    syscall(SYS_set_mempolicy, saved.mode, &saved.nodes, sizeof(saved.nodes) * 8 + 1);
+#else
+  (void)saved;
+#endif
+}
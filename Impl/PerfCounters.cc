@@ -0,0 +1,142 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "PerfCounters.hh"
+// C++ C Lib
+#include <cstring>
+#if defined(__linux__)
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#endif
+using namespace fourcrypt;
+
+#if defined(__linux__)
+/* Open one counter of the calling thread and its future children, as a member of the group led by
+ * @group_fd or as the leader of a new group if @group_fd is -1. The counter starts disabled. */
+static int
+open_counter(uint32_t type, uint64_t config, int group_fd)
+{
+  struct perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = type;
+  attr.config         = config;
+  attr.disabled       = (group_fd == -1);
+  attr.inherit        = 1; // Count the KDF threads, which are spawned after the counters are opened.
+  attr.exclude_kernel = 1; // Permitted at perf_event_paranoid 2.
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+}
+
+static constexpr uint64_t
+cache_config(uint64_t cache, uint64_t op, uint64_t result)
+{
+  return cache | (op << 8) | (result << 16);
+}
+#endif
+
+PerfCounters::~PerfCounters()
+{
+  this->close();
+}
+
+bool PerfCounters::open(void)
+{
+  this->close();
+ #if defined(__linux__)
+  // The hardware counters form one group so that they're scheduled onto the PMU together.
+  int& leader {this->fds[CYCLES]};
+  leader = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+  this->fds[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, leader);
+  this->fds[LLC_MISSES] = open_counter(
+   PERF_TYPE_HW_CACHE,
+   cache_config(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+   leader);
+  this->fds[DTLB_MISSES] = open_counter(
+   PERF_TYPE_HW_CACHE,
+   cache_config(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS),
+   leader);
+  this->fds[PAGE_FAULTS] = open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, -1);
+  if (leader != -1)
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  else {
+    // Without a leader the other hardware counters were opened as leaders of their own groups.
+    for (int c : {INSTRUCTIONS, LLC_MISSES, DTLB_MISSES}) {
+      if (this->fds[c] != -1)
+        ioctl(this->fds[c], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  if (this->fds[PAGE_FAULTS] != -1)
+    ioctl(this->fds[PAGE_FAULTS], PERF_EVENT_IOC_ENABLE, 0);
+ #endif
+  return this->anyAvailable();
+}
+
+void PerfCounters::close(void)
+{
+ #if defined(__linux__)
+  // Close the group members before their leader.
+  for (int c {COUNT - 1}; c >= 0; --c) {
+    if (this->fds[c] != -1)
+      ::close(this->fds[c]);
+    this->fds[c] = -1;
+  }
+ #endif
+}
+
+bool PerfCounters::available(Counter c) const
+{
+  return this->fds[c] != -1;
+}
+
+bool PerfCounters::anyAvailable(void) const
+{
+  for (int fd : this->fds) {
+    if (fd != -1)
+      return true;
+  }
+  return false;
+}
+
+void PerfCounters::read(Values_t& values) const
+{
+  values.fill(0);
+ #if defined(__linux__)
+  for (int c {0}; c < COUNT; ++c) {
+    if (this->fds[c] == -1)
+      continue;
+    uint64_t buf[3]; // Value, time enabled, time running.
+    if (::read(this->fds[c], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf)) or buf[2] == 0)
+      continue;
+    if (buf[2] < buf[1])
+      values[c] = static_cast<uint64_t>(static_cast<double>(buf[0]) * (static_cast<double>(buf[1]) / static_cast<double>(buf[2])));
+    else
+      values[c] = buf[0];
+  }
+ #endif
+}
+
+const char* PerfCounters::name(Counter c)
+{
+  static const char* names[] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "page_faults"
+  };
+  static_assert(sizeof(names) / sizeof(names[0]) == COUNT);
+  return names[c];
+}
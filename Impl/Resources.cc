@@ -0,0 +1,272 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Resources.hh"
+#include "Core.hh"
+// SSC
+#include <SSC/Memory.h>
+// C++ STL
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+// C++ C Lib
+#include <cinttypes>
+#include <cstdlib>
+#if defined(__linux__)
+ #include <sched.h>
+#endif
+using namespace fourcrypt;
+
+#if defined(__linux__)
+// cgroup v1 reports "no limit" as a huge, page-aligned number rather than a keyword.
+constexpr uint64_t CGROUP_V1_UNLIMITED {UINT64_C(1) << 62};
+
+/* Read the first whitespace-delimited token of the file at @path into @token. */
+static bool
+read_token(const std::string& path, std::string& token)
+{
+  std::ifstream in {path};
+  return static_cast<bool>(in >> token);
+}
+
+/* Read an unsigned integer from the file at @path. "max" is returned as UINT64_MAX. */
+static bool
+read_u64(const std::string& path, uint64_t& value)
+{
+  std::string token {};
+  if (not read_token(path, token))
+    return false;
+  if (token == "max") {
+    value = UINT64_MAX;
+    return true;
+  }
+  char* end;
+  value = std::strtoull(token.c_str(), &end, 10);
+  return *end == '\0';
+}
+
+/* Return the value of @key within a memory.stat file, or 0. */
+static uint64_t
+read_stat(const std::string& path, const char* key)
+{
+  std::ifstream in {path};
+  std::string   k {};
+  uint64_t      v {};
+  while (in >> k >> v) {
+    if (k == key)
+      return v;
+  }
+  return 0;
+}
+
+/* Account for a cgroup's memory @limit and @usage, less its @reclaimable page cache, keeping
+ * whichever limit leaves the least memory available.
+ */
+static void
+consider_memory(Resources& r, uint64_t limit, uint64_t usage, uint64_t reclaimable)
+{
+  usage = (usage > reclaimable) ? (usage - reclaimable) : 0;
+  if (usage > limit)
+    usage = limit;
+  if (r.cgroup_memory_limit == 0 || (limit - usage) < (r.cgroup_memory_limit - r.cgroup_memory_usage)) {
+    r.cgroup_memory_limit = limit;
+    r.cgroup_memory_usage = usage;
+  }
+}
+
+static void
+consider_quota(Resources& r, double quota)
+{
+  if (quota > 0.0 && (r.cpu_quota == 0.0 || quota < r.cpu_quota))
+    r.cpu_quota = quota;
+}
+
+/* cgroup v2: a single "0::<path>" line. Walk from our cgroup up to the root of the hierarchy, since
+ * any ancestor's limit applies to us as well.
+ */
+static bool
+detect_cgroup_v2(Resources& r, const std::string& rel)
+{
+  const std::string root {"/sys/fs/cgroup"};
+  std::string       dir  {root + rel};
+  bool              found {false};
+  for (;;) {
+    uint64_t limit, usage;
+    if (read_u64(dir + "/memory.max", limit)) {
+      found = true;
+      if (limit != UINT64_MAX && read_u64(dir + "/memory.current", usage))
+        consider_memory(r, limit, usage, read_stat(dir + "/memory.stat", "inactive_file"));
+    }
+    std::ifstream cpu {dir + "/cpu.max"};
+    std::string   quota {};
+    uint64_t      period {};
+    if (cpu >> quota >> period) {
+      found = true;
+      if (quota != "max" && period != 0)
+        consider_quota(r, std::strtod(quota.c_str(), nullptr) / static_cast<double>(period));
+    }
+    if (dir.size() <= root.size())
+      break;
+    dir.erase(dir.rfind('/'));
+  }
+  return found;
+}
+
+/* cgroup v1: "<id>:<controller,...>:<path>" lines; each controller has its own hierarchy. Inside a
+ * container the listed path may not exist in the container's view, so fall back to the mount root.
+ */
+static bool
+detect_cgroup_v1(Resources& r, const std::string& controllers, const std::string& rel)
+{
+  auto has = [&controllers](const char* name) -> bool {
+    size_t pos {0};
+    while (pos <= controllers.size()) {
+      size_t end {controllers.find(',', pos)};
+      if (end == std::string::npos)
+        end = controllers.size();
+      if (controllers.compare(pos, end - pos, name) == 0)
+        return true;
+      pos = end + 1;
+    }
+    return false;
+  };
+  bool found {false};
+  if (has("memory")) {
+    for (const std::string& dir : {"/sys/fs/cgroup/memory" + rel, std::string{"/sys/fs/cgroup/memory"}}) {
+      uint64_t limit, usage;
+      if (read_u64(dir + "/memory.limit_in_bytes", limit) && read_u64(dir + "/memory.usage_in_bytes", usage)) {
+        found = true;
+        if (limit < CGROUP_V1_UNLIMITED)
+          consider_memory(r, limit, usage, read_stat(dir + "/memory.stat", "total_inactive_file"));
+        break;
+      }
+    }
+  }
+  if (has("cpu")) {
+    const std::string mount {"/sys/fs/cgroup/" + controllers};
+    for (const std::string& dir : {mount + rel, mount}) {
+      std::string quota {};
+      uint64_t    period {};
+      if (read_token(dir + "/cpu.cfs_quota_us", quota) && read_u64(dir + "/cpu.cfs_period_us", period)) {
+        found = true;
+        const double q {std::strtod(quota.c_str(), nullptr)};
+        if (q > 0.0 && period != 0)
+          consider_quota(r, q / static_cast<double>(period));
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+static void
+detect_cgroups(Resources& r)
+{
+  std::ifstream in {"/proc/self/cgroup"};
+  std::string   line {};
+  bool          v1 {false}, v2 {false};
+  while (std::getline(in, line)) {
+    const size_t first  {line.find(':')};
+    const size_t second {(first == std::string::npos) ? first : line.find(':', first + 1)};
+    if (second == std::string::npos)
+      continue;
+    const std::string controllers {line.substr(first + 1, second - first - 1)};
+    std::string       rel         {line.substr(second + 1)};
+    if (rel == "/")
+      rel.clear();
+    if (line.compare(0, first, "0") == 0 && controllers.empty())
+      v2 = detect_cgroup_v2(r, rel) || v2;
+    else if (not controllers.empty())
+      v1 = detect_cgroup_v1(r, controllers, rel) || v1;
+  }
+  if (v2)
+    r.cgroup_version = 2;
+  else if (v1)
+    r.cgroup_version = 1;
+}
+#endif /* __linux__ */
+
+Resources
+Resources::detect(void)
+{
+  Resources r {};
+  r.processors = static_cast<uint64_t>(std::max(SSC_getNumberProcessors(), 1));
+#ifdef SSC_HAS_GETAVAILABLESYSTEMMEMORY
+  r.host_memory_available = static_cast<uint64_t>(SSC_getAvailableSystemMemory());
+#endif
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    r.affinity_processors = static_cast<uint64_t>(CPU_COUNT(&set));
+  detect_cgroups(r);
+#endif
+  return r;
+}
+
+uint64_t
+Resources::availableMemory(void) const
+{
+  uint64_t available {host_memory_available};
+  if (cgroup_memory_limit != 0) {
+    const uint64_t cgroup_available {cgroup_memory_limit - cgroup_memory_usage};
+    if (available == 0 || cgroup_available < available)
+      available = cgroup_available;
+  }
+  return available;
+}
+
+uint64_t
+Resources::usableProcessors(void) const
+{
+  uint64_t n {processors};
+  if (affinity_processors != 0)
+    n = std::min(n, affinity_processors);
+  if (cpu_quota > 0.0)
+    n = std::min(n, static_cast<uint64_t>(std::ceil(cpu_quota)));
+  return std::max<uint64_t>(n, 1);
+}
+
+void
+Resources::print(std::FILE* f) const
+{
+  auto memory = [](uint64_t bytes) -> std::string {
+    return (bytes != 0) ? Core::makeMemoryString(bytes) : std::string{"unknown"};
+  };
+  std::fprintf(f, "Online processors...............%" PRIu64 "\n", processors);
+  if (affinity_processors != 0)
+    std::fprintf(f, "Schedulable processors..........%" PRIu64 "\n", affinity_processors);
+  else
+    std::fprintf(f, "Schedulable processors..........unknown\n");
+  if (cpu_quota > 0.0)
+    std::fprintf(f, "cgroup CPU quota................%.2f processor(s)\n", cpu_quota);
+  else
+    std::fprintf(f, "cgroup CPU quota................unlimited\n");
+  std::fprintf(f, "Usable processors...............%" PRIu64 "\n", this->usableProcessors());
+  std::fprintf(f, "Host memory available...........%s\n", memory(host_memory_available).c_str());
+  if (cgroup_version != 0)
+    std::fprintf(f, "cgroup version..................v%d\n", cgroup_version);
+  else
+    std::fprintf(f, "cgroup version..................none\n");
+  if (cgroup_memory_limit != 0) {
+    std::fprintf(f, "cgroup memory limit.............%s\n", Core::makeMemoryString(cgroup_memory_limit).c_str());
+    std::fprintf(f, "cgroup memory in use............%s\n", Core::makeMemoryString(cgroup_memory_usage).c_str());
+  }
+  else
+    std::fprintf(f, "cgroup memory limit.............unlimited\n");
+  std::fprintf(f, "Available memory................%s\n", memory(this->availableMemory()).c_str());
+}
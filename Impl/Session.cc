@@ -0,0 +1,165 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Session.hh"
+// C++ C Lib
+#include <cstring>
+using namespace fourcrypt;
+
+using PlainOldData = Core::PlainOldData;
+
+/* Allocate a NUL-terminated copy of @str into @to, the way Core expects filenames. */
+static void
+copy_filename(char** to, uint64_t* size, const std::string& str)
+{
+  *to = new char[str.size() + 1];
+  std::memcpy(*to, str.c_str(), str.size() + 1);
+  *size = str.size();
+}
+
+bool
+Session::Job::setPassword(const void* pw, size_t size)
+{
+  this->clearPassword();
+  if (size == 0 or size > Core::MAX_PW_BYTES)
+    return false;
+  std::memcpy(this->password_buffer, pw, size);
+  this->password_size = size;
+  return true;
+}
+
+void
+Session::Job::clearPassword()
+{
+  SSC_secureZero(this->password_buffer, sizeof(this->password_buffer));
+  this->password_size = 0;
+}
+
+Session::Job::~Job()
+{
+  this->clearPassword();
+}
+
+void
+Session::configure(const Job& job, PlainOldData& pod)
+{
+  if (not job.input.empty())
+    copy_filename(&pod.input_filename, &pod.input_filename_size, job.input);
+  if (not job.output.empty())
+    copy_filename(&pod.output_filename, &pod.output_filename_size, job.output);
+  std::memcpy(pod.password_buffer, job.password_buffer, sizeof(pod.password_buffer));
+  pod.password_size     = job.password_size;
+  pod.execute_mode      = job.mode;
+  pod.thread_count      = job.thread_count;
+  pod.thread_batch_size = job.thread_batch_size;
+  pod.padding_size      = job.padding_size;
+  pod.padding_mode      = job.padding_mode;
+  pod.memory_low        = job.memory_low;
+  pod.memory_high       = job.memory_high;
+  pod.iterations        = job.iterations;
+  pod.flags             = job.flags;
+  switch (job.preset) {
+    case Preset::FAST:
+      PlainOldData::set_fast(pod);
+      break;
+    case Preset::NORMAL:
+      PlainOldData::set_normal(pod);
+      break;
+    case Preset::STRONG:
+      PlainOldData::set_strong(pod);
+      break;
+    case Preset::NONE:
+      break;
+  }
+  PlainOldData::touchup(pod);
+}
+
+void
+Session::setMemoryBudget(MemoryBudget* budget)
+{
+  this->memory_budget = budget;
+}
+
+Session::~Session()
+{
+  this->kdf_gate.acquire();
+}
+
+Session::Result
+Session::run(const Job& job)
+{
+  Core core {};
+  return this->run(job, core);
+}
+
+void
+Session::begin(const Job& job, Core& core)
+{
+  core.reset();
+  Session::configure(job, *core.getPod());
+  core.setStats(job.stats);
+  // A shared memory budget admits concurrent KDFs by their size; otherwise they take turns.
+  if (this->memory_budget != nullptr)
+    core.setMemoryBudget(this->memory_budget);
+  else
+    core.setKdfGate(&this->kdf_gate);
+}
+
+void
+Session::end(Core& core)
+{
+  core.setKdfGate(nullptr);
+  core.setMemoryBudget(nullptr);
+  core.setStats(nullptr);
+  // Don't leave keys or the password behind in the Core once the job is over.
+  core.reset();
+}
+
+Session::Result
+Session::run(const Job& job, Core& core, Core::StatusCallback_f* status_callback, void* scb_data)
+{
+  Result result {};
+  this->begin(job, core);
+  switch (job.mode) {
+    case Core::ExeMode::ENCRYPT:
+      result.code = core.encrypt(&result.type, &result.dir, status_callback, scb_data);
+      break;
+    case Core::ExeMode::DECRYPT:
+      result.code = core.decrypt(&result.type, &result.dir, status_callback, scb_data);
+      break;
+    case Core::ExeMode::VERIFY:
+      result.code = core.verify(&result.type, &result.dir, status_callback, scb_data);
+      break;
+    default: // Core::ExeMode::DESCRIBE
+      result.code = core.describe(&result.type, &result.dir, status_callback, scb_data);
+      break;
+  }
+  this->end(core);
+  return result;
+}
+
+Session::Result
+Session::runBuffer(const Job& job, Core& core, std::span<uint8_t> output, std::span<const uint8_t> input, uint64_t* output_size)
+{
+  Result result {};
+  this->begin(job, core);
+  if (job.mode == Core::ExeMode::DECRYPT)
+    result.code = core.decryptBuffer(output, input, output_size);
+  else
+    result.code = core.encryptBuffer(output, input, output_size);
+  this->end(core);
+  return result;
+}
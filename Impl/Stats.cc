@@ -0,0 +1,201 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Stats.hh"
+// C++ C Lib
+#include <cinttypes>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <sys/resource.h>
+#endif
+using namespace fourcrypt;
+
+/* Return the throughput of @bytes over @ns nanoseconds in MiB per second, or 0 if undefined. */
+static double
+mib_per_second(uint64_t bytes, uint64_t ns)
+{
+  if (bytes == 0 or ns == 0)
+    return 0.0;
+  return (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (static_cast<double>(ns) / 1e9);
+}
+
+void Stats::setCounters(const PerfCounters* pc)
+{
+  this->perf_counters = pc;
+}
+
+bool Stats::haveCounters(void) const
+{
+  return this->perf_counters != nullptr and this->perf_counters->anyAvailable();
+}
+
+void Stats::begin(Phase_t phase)
+{
+  Entry& e {this->entries[static_cast<int>(phase)]};
+  // Read the counters first, so that the clock isn't charged for reading them.
+  if (this->perf_counters != nullptr)
+    this->perf_counters->read(e.start_counters);
+  e.start = Clock_t::now();
+}
+
+void Stats::end(Phase_t phase, uint64_t bytes)
+{
+  Entry& e {this->entries[static_cast<int>(phase)]};
+  const auto elapsed {std::chrono::duration_cast<std::chrono::nanoseconds>(Clock_t::now() - e.start)};
+  e.nanoseconds += static_cast<uint64_t>(elapsed.count());
+  e.bytes += bytes;
+  ++e.count;
+  if (this->perf_counters != nullptr) {
+    PerfCounters::Values_t now;
+    this->perf_counters->read(now);
+    for (int c {0}; c < PerfCounters::COUNT; ++c) {
+      if (now[c] > e.start_counters[c])
+        e.counters[c] += now[c] - e.start_counters[c];
+    }
+  }
+}
+
+const Stats::Entry& Stats::get(Phase_t phase) const
+{
+  return this->entries[static_cast<int>(phase)];
+}
+
+uint64_t Stats::totalNanoseconds(void) const
+{
+  uint64_t total {0};
+  for (const Entry& e : this->entries)
+    total += e.nanoseconds;
+  return total;
+}
+
+uint64_t Stats::peakResidentBytes(void)
+{
+ #if defined(SSC_OS_UNIXLIKE)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  #if defined(__APPLE__)
+  return static_cast<uint64_t>(usage.ru_maxrss);        // Bytes.
+  #else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // Kibibytes.
+  #endif
+ #else
+  return 0;
+ #endif
+}
+
+void Stats::print(std::FILE* f, Core::ReportFormat format) const
+{
+  switch (format) {
+    case Core::ReportFormat::TEXT:
+      this->printText(f);
+      break;
+    case Core::ReportFormat::JSON:
+      this->printJson(f);
+      break;
+    default:
+      break;
+  }
+}
+
+void Stats::printText(std::FILE* f) const
+{
+  const bool have_counters {this->haveCounters()};
+  std::fprintf(f, "%-12s %12s %14s %12s", "Phase", "Seconds", "Bytes", "MiB/s");
+  if (have_counters)
+    std::fprintf(f, " %10s %6s %12s %12s %10s", "Cycles/B", "IPC", "LLC misses", "dTLB misses", "Faults");
+  std::fputc('\n', f);
+  for (int i {0}; i < NUM_PHASES; ++i) {
+    const Entry& e {this->entries[i]};
+    if (e.count == 0)
+      continue;
+    const char* name {Core::phaseName(static_cast<Phase_t>(i))};
+    const double seconds {static_cast<double>(e.nanoseconds) / 1e9};
+    if (e.bytes != 0)
+      std::fprintf(f, "%-12s %12.6f %14" PRIu64 " %12.1f", name, seconds, e.bytes, mib_per_second(e.bytes, e.nanoseconds));
+    else
+      std::fprintf(f, "%-12s %12.6f %14s %12s", name, seconds, "-", "-");
+    if (have_counters)
+      this->printTextCounters(f, e);
+    std::fputc('\n', f);
+  }
+  std::fprintf(f, "%-12s %12.6f\n", "total", static_cast<double>(this->totalNanoseconds()) / 1e9);
+  const uint64_t rss {Stats::peakResidentBytes()};
+  if (rss != 0)
+    std::fprintf(f, "Peak resident memory: %s\n", Core::makeMemoryString(rss).c_str());
+}
+
+/* Print the counter columns of @e, with "-" for unavailable counters and undefined ratios. */
+void Stats::printTextCounters(std::FILE* f, const Entry& e) const
+{
+  const PerfCounters* pc {this->perf_counters};
+  const uint64_t cycles {e.counters[PerfCounters::CYCLES]};
+  if (pc->available(PerfCounters::CYCLES) and e.bytes != 0)
+    std::fprintf(f, " %10.3f", static_cast<double>(cycles) / static_cast<double>(e.bytes));
+  else
+    std::fprintf(f, " %10s", "-");
+  if (pc->available(PerfCounters::CYCLES) and pc->available(PerfCounters::INSTRUCTIONS) and cycles != 0)
+    std::fprintf(f, " %6.2f", static_cast<double>(e.counters[PerfCounters::INSTRUCTIONS]) / static_cast<double>(cycles));
+  else
+    std::fprintf(f, " %6s", "-");
+  const int widths[] {12, 12, 10};
+  const PerfCounters::Counter columns[] {PerfCounters::LLC_MISSES, PerfCounters::DTLB_MISSES, PerfCounters::PAGE_FAULTS};
+  for (int i {0}; i < 3; ++i) {
+    if (pc->available(columns[i]))
+      std::fprintf(f, " %*" PRIu64, widths[i], e.counters[columns[i]]);
+    else
+      std::fprintf(f, " %*s", widths[i], "-");
+  }
+}
+
+void Stats::printJson(std::FILE* f) const
+{
+  std::fprintf(f, "{\"phases\":[");
+  bool first {true};
+  for (int i {0}; i < NUM_PHASES; ++i) {
+    const Entry& e {this->entries[i]};
+    if (e.count == 0)
+      continue;
+    std::fprintf(
+     f,
+     "%s{\"name\":\"%s\",\"count\":%" PRIu64 ",\"ns\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"mib_per_s\":%.3f",
+     first ? "" : ",",
+     Core::phaseName(static_cast<Phase_t>(i)),
+     e.count,
+     e.nanoseconds,
+     e.bytes,
+     mib_per_second(e.bytes, e.nanoseconds));
+    if (this->haveCounters()) {
+      // Unavailable counters are omitted rather than reported as 0.
+      std::fprintf(f, ",\"counters\":{");
+      bool first_counter {true};
+      for (int c {0}; c < PerfCounters::COUNT; ++c) {
+        const auto counter {static_cast<PerfCounters::Counter>(c)};
+        if (not this->perf_counters->available(counter))
+          continue;
+        std::fprintf(f, "%s\"%s\":%" PRIu64, first_counter ? "" : ",", PerfCounters::name(counter), e.counters[c]);
+        first_counter = false;
+      }
+      std::fputc('}', f);
+    }
+    std::fputc('}', f);
+    first = false;
+  }
+  std::fprintf(
+   f,
+   "],\"total_ns\":%" PRIu64 ",\"peak_rss_bytes\":%" PRIu64 "}\n",
+   this->totalNanoseconds(),
+   Stats::peakResidentBytes());
+}
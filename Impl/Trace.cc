@@ -0,0 +1,178 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "Trace.hh"
+// C++ STL
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+// C++ C Lib
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <unistd.h>
+#elif defined(SSC_OS_WINDOWS)
+ #include <process.h>
+#endif
+using namespace fourcrypt;
+using Clock_t = std::chrono::steady_clock;
+
+std::atomic<bool> Trace::is_enabled {false};
+
+struct TraceEvent
+ {
+  const char* name;
+  const char* category;
+  uint64_t    ns;   // Nanoseconds since the trace started.
+  uint64_t    arg;
+  char        type; // 'B'egin or 'E'nd.
+ };
+
+// One thread's events. Only the owning thread writes; Trace::dump() reads.
+struct TraceRing
+ {
+  std::unique_ptr<TraceEvent[]> events {new TraceEvent[Trace::EVENTS_PER_THREAD]};
+  std::atomic<uint64_t>         head   {0}; // How many events have ever been recorded.
+  const char*                   thread_name {nullptr};
+  uint64_t                      tid    {0};
+ };
+
+static std::mutex                              rings_mtx;
+static std::vector<std::unique_ptr<TraceRing>> rings; // Owned here so that rings outlive their threads.
+static std::string                             dump_path;
+static Clock_t::time_point                     epoch;
+static thread_local TraceRing*                 this_ring {nullptr};
+
+/* Return the calling thread's ring, registering a new one the first time. */
+static TraceRing*
+get_ring(void)
+{
+  if (this_ring == nullptr) {
+    std::lock_guard lg {rings_mtx};
+    rings.emplace_back(std::make_unique<TraceRing>());
+    this_ring = rings.back().get();
+    this_ring->tid = rings.size();
+  }
+  return this_ring;
+}
+
+/* Write @s to @f as the body of a JSON string. */
+static void
+print_json_string(std::FILE* f, const char* s)
+{
+  for (; *s != '\0'; ++s) {
+    if (*s == '"' or *s == '\\')
+      std::fputc('\\', f);
+    if (static_cast<unsigned char>(*s) >= 0x20)
+      std::fputc(*s, f);
+  }
+}
+
+void Trace::start(const std::string& path)
+{
+  {
+    std::lock_guard lg {rings_mtx};
+    dump_path = path;
+    epoch     = Clock_t::now();
+  }
+  if (not is_enabled.exchange(true, std::memory_order_release)) {
+    // Dump on every exit path, including SSC_errx().
+    std::atexit([]() { Trace::dump(); });
+  }
+  Trace::setThreadName("main");
+}
+
+void Trace::record(char type, const char* name, const char* category, uint64_t arg)
+{
+  const auto ns {std::chrono::duration_cast<std::chrono::nanoseconds>(Clock_t::now() - epoch).count()};
+  TraceRing* ring {get_ring()};
+  const uint64_t h {ring->head.load(std::memory_order_relaxed)};
+  ring->events[h & (EVENTS_PER_THREAD - 1)] = TraceEvent{name, category, static_cast<uint64_t>(ns), arg, type};
+  ring->head.store(h + 1, std::memory_order_release);
+}
+
+void Trace::begin(const char* name, const char* category, uint64_t arg)
+{
+  if (Trace::enabled())
+    Trace::record('B', name, category, arg);
+}
+
+void Trace::end(const char* name, const char* category, uint64_t arg)
+{
+  if (Trace::enabled())
+    Trace::record('E', name, category, arg);
+}
+
+void Trace::setThreadName(const char* name)
+{
+  if (Trace::enabled())
+    get_ring()->thread_name = name;
+}
+
+bool Trace::dump(void)
+{
+  std::lock_guard lg {rings_mtx};
+  if (dump_path.empty())
+    return false;
+  std::FILE* f {std::fopen(dump_path.c_str(), "w")};
+  if (f == nullptr)
+    return false;
+ #if defined(SSC_OS_UNIXLIKE)
+  const long pid {static_cast<long>(getpid())};
+ #elif defined(SSC_OS_WINDOWS)
+  const long pid {static_cast<long>(_getpid())};
+ #else
+  const long pid {1};
+ #endif
+  std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+  bool first {true};
+  for (const auto& ring : rings) {
+    if (ring->thread_name != nullptr) {
+      std::fprintf(
+       f,
+       "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%" PRIu64 ",\"args\":{\"name\":\"",
+       first ? "" : ",\n",
+       pid,
+       ring->tid);
+      print_json_string(f, ring->thread_name);
+      std::fputs("\"}}", f);
+      first = false;
+    }
+    const uint64_t head  {ring->head.load(std::memory_order_acquire)};
+    const uint64_t begin {head > EVENTS_PER_THREAD ? head - EVENTS_PER_THREAD : 0};
+    for (uint64_t i {begin}; i < head; ++i) {
+      const TraceEvent& e {ring->events[i & (EVENTS_PER_THREAD - 1)]};
+      std::fprintf(f, "%s{\"name\":\"", first ? "" : ",\n");
+      print_json_string(f, e.name);
+      std::fputs("\",\"cat\":\"", f);
+      print_json_string(f, e.category);
+      std::fprintf(
+       f,
+       "\",\"ph\":\"%c\",\"ts\":%" PRIu64 ".%03u,\"pid\":%ld,\"tid\":%" PRIu64 ",\"args\":{\"arg\":%" PRIu64 "}}",
+       e.type,
+       e.ns / 1000,
+       static_cast<unsigned>(e.ns % 1000),
+       pid,
+       ring->tid,
+       e.arg);
+      first = false;
+    }
+  }
+  std::fputs("]}\n", f);
+  return std::fclose(f) == 0;
+}
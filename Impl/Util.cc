@@ -18,11 +18,20 @@
 
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
 #include <cinttypes>
 #include <cctype>
 
 #include <SSC/Error.h>
 #include <SSC/SSC_String.h>
+#if defined(SSC_OS_UNIXLIKE)
+ #include <unistd.h>
+#endif
+#if defined(__APPLE__)
+ #include <sys/sysctl.h>
+#elif defined(SSC_OS_WINDOWS)
+ #include <windows.h>
+#endif
 #define R_ SSC_RESTRICT
 
 using namespace fourcrypt;
@@ -119,3 +128,105 @@ fourcrypt::parse_integer(const char* R_ cstr, const size_t len)
   delete[] temp;
   return integer;
 }
+
+uint64_t
+fourcrypt::parse_bytes(const char* R_ str, const size_t len)
+{
+  char* const temp = new char[len + 1];
+  std::memcpy(temp, str, len + 1);
+  uint64_t multiplier = 1;
+  for (size_t i = 0; i < len; ++i) {
+    switch (std::toupper(static_cast<unsigned char>(str[i]))) {
+      case 'K':
+        multiplier = KIBIBYTE;
+        goto have_multiplier;
+      case 'M':
+        multiplier = MEBIBYTE;
+        goto have_multiplier;
+      case 'G':
+        multiplier = GIBIBYTE;
+        goto have_multiplier;
+      default:
+        SSC_assertMsg(isdigit(static_cast<unsigned char>(str[i])), "Invalid size '%s'!\n", str);
+    }
+  }
+  uint64_t num_digits;
+have_multiplier:
+  num_digits = static_cast<uint64_t>(SSC_Cstr_shiftDigitsToFront(temp, len));
+  SSC_assertMsg(num_digits > 0 and num_digits < 20, "Invalid size '%s'!\n", str);
+  const uint64_t count = static_cast<uint64_t>(std::strtoumax(temp, nullptr, 10));
+  delete[] temp;
+  SSC_assertMsg(count <= (UINT64_MAX / multiplier), "Size '%s' overflows!\n", str);
+  return count * multiplier;
+}
+
+std::string
+fourcrypt::get_hostname(void)
+{
+#if defined(SSC_OS_UNIXLIKE)
+  char name [256] {};
+  if (gethostname(name, sizeof(name) - 1) == 0 && name[0] != '\0')
+    return std::string{name};
+#elif defined(SSC_OS_WINDOWS)
+  if (const char* name {std::getenv("COMPUTERNAME")}; name != nullptr)
+    return std::string{name};
+#endif
+  return std::string{"localhost"};
+}
+
+std::string
+fourcrypt::get_cpu_model(void)
+{
+  std::string model {};
+#if defined(__linux__)
+  if (std::FILE* f {std::fopen("/proc/cpuinfo", "r")}; f != nullptr) {
+    char line [512];
+    while (model.empty() and std::fgets(line, sizeof(line), f) != nullptr) {
+      // x86 names its processor "model name"; many ARM kernels only give a "Hardware" line.
+      if (std::strncmp(line, "model name", 10) != 0 and std::strncmp(line, "Hardware", 8) != 0)
+        continue;
+      if (const char* colon {std::strchr(line, ':')}; colon != nullptr)
+        model = colon + 1;
+    }
+    std::fclose(f);
+  }
+#elif defined(__APPLE__)
+  char brand [256] {};
+  size_t size {sizeof(brand) - 1};
+  if (sysctlbyname("machdep.cpu.brand_string", brand, &size, nullptr, 0) == 0)
+    model = brand;
+#elif defined(SSC_OS_WINDOWS)
+  if (const char* id {std::getenv("PROCESSOR_IDENTIFIER")}; id != nullptr)
+    model = id;
+#endif
+  // Collapse every run of whitespace into a single '_', and trim both ends.
+  std::string out {};
+  for (const char c : model) {
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      if (not out.empty() and out.back() != '_')
+        out.push_back('_');
+    }
+    else
+      out.push_back(c);
+  }
+  while (not out.empty() and out.back() == '_')
+    out.pop_back();
+  return out.empty() ? std::string{"unknown"} : out;
+}
+
+uint64_t
+fourcrypt::get_total_memory(void)
+{
+#if defined(SSC_OS_UNIXLIKE) && defined(_SC_PHYS_PAGES)
+  const long pages {sysconf(_SC_PHYS_PAGES)};
+  const long page  {sysconf(_SC_PAGESIZE)};
+  if (pages > 0 and page > 0)
+    return static_cast<uint64_t>(pages) * static_cast<uint64_t>(page);
+#elif defined(SSC_OS_WINDOWS)
+  MEMORYSTATUSEX status {};
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status))
+    return static_cast<uint64_t>(status.ullTotalPhys);
+#endif
+  return 0;
+}
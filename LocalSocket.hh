@@ -0,0 +1,58 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_LOCALSOCKET_HH
+#define FOURCRYPT_LOCALSOCKET_HH
+#include <SSC/Macro.h>
+#include <string>
+
+namespace fourcrypt
+ {
+  /* Helpers for the per-user Unix domain sockets of 4crypt-agent and 4cryptd. Both ends of every
+   * connection verify that the other runs as the same user. On systems without Unix domain sockets
+   * every procedure fails. */
+
+  /* Return the default path of the socket called @name: $XDG_RUNTIME_DIR/4crypt-<name>.sock when
+   * $XDG_RUNTIME_DIR is set, otherwise /tmp/4crypt-<uid>/<name>.sock. */
+  std::string
+  local_socket_path(const char* name);
+
+  /* Connect to the socket at @path, verify that its listener runs as the calling user, and give the
+   * connection send and receive timeouts of @timeout_ms. Return the connected socket, or -1. */
+  int
+  local_connect(const std::string& path, unsigned timeout_ms);
+
+  /* Listen on a socket at @path that only the calling user may connect to, replacing the socket of
+   * a listener that is no longer running. Print an error and exit on failure. */
+  int
+  local_listen(const std::string& path);
+
+  /* Give @fd send and receive timeouts of @timeout_ms. */
+  void
+  local_set_timeouts(int fd, unsigned timeout_ms);
+
+  /* Return true if the peer of the connected socket @fd runs as the calling user. */
+  bool
+  local_peer_is_self(int fd);
+
+  /* Send or receive exactly @size bytes over @fd. Return false on error, timeout or EOF. */
+  bool
+  local_send_all(int fd, const void* buf, size_t size);
+
+  bool
+  local_recv_all(int fd, void* buf, size_t size);
+ }
+#endif
@@ -0,0 +1,58 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_MEMORYBUDGET_HH
+#define FOURCRYPT_MEMORYBUDGET_HH
+
+// Local
+#include "Core.hh"
+// C++ STL
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+namespace fourcrypt
+ {
+  /* A number of bytes shared between concurrent KDFs, see Core::setMemoryBudget(). Rather than each
+   * KDF planning against the memory available at the time, and several of them counting the same
+   * free memory, every KDF reserves what it will allocate and waits until that fits.
+   */
+  class MemoryBudget
+   {
+   public:
+    explicit MemoryBudget(uint64_t bytes);
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    /* Wait until @bytes fit alongside every reservation still held, then reserve them and return true.
+     * Reservations are granted in the order they were asked for, so that large ones can't starve; one
+     * larger than the whole budget is granted once nothing else is reserved. Return false without
+     * reserving anything if @cancel is cancelled while waiting. */
+    bool     acquire(uint64_t bytes, const Core::CancelToken* cancel = nullptr);
+    /* Return @bytes reserved by acquire(). */
+    void     release(uint64_t bytes);
+    uint64_t capacity(void) const;
+    uint64_t reserved(void) const;
+   private:
+    mutable std::mutex      mtx         {};
+    std::condition_variable cv          {};
+    std::list<uint64_t>     waiting     {}; // Tickets of the waiting reservations, oldest first.
+    uint64_t                total;
+    uint64_t                in_use      {0};
+    uint64_t                next_ticket {0};
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,76 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_METRICS_HH
+#define FOURCRYPT_METRICS_HH
+// Local
+#include "Core.hh"
+// C++ STL
+#include <atomic>
+#include <string>
+
+namespace fourcrypt
+ {
+  /* Process-wide counters and latency histograms, exported in the Prometheus text format to a file
+   * for node_exporter's textfile collector.
+   *
+   * Every update is a relaxed atomic add on its own cache line; nothing locks until the export.
+   * Cores only update the metrics a handful of times per operation, never per tile, and while
+   * no export is started an update costs one relaxed atomic load.
+   */
+  class Metrics
+   {
+   public:
+    enum class Counter
+     {
+      BYTES_ENCRYPTED,  // Plaintext bytes encrypted.
+      BYTES_DECRYPTED,  // Plaintext bytes decrypted.
+      FILES_ENCRYPTED,  // Files encrypted successfully.
+      FILES_DECRYPTED,  // Files decrypted successfully.
+      FILES_VERIFIED,   // Files verified successfully.
+      MAC_FAILURES,     // MACs that didn't match, i.e. wrong passwords or corrupted files.
+      KDF_INVOCATIONS,  // KDFs computed.
+      KDF_CACHE_HITS,   // KDF outputs taken from 4crypt-agent instead.
+      COUNT
+     };
+    // The upper bounds of the latency histogram buckets, in seconds; an implicit +Inf bucket follows.
+    static constexpr double BUCKET_SECONDS[] {
+     0.0001, 0.001, 0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0
+    };
+    static constexpr int NUM_BUCKETS {static_cast<int>(sizeof(BUCKET_SECONDS) / sizeof(BUCKET_SECONDS[0])) + 1};
+
+    /* Start collecting, and export to @path when the process exits.
+     * With an @interval_seconds of 0 the export adds onto the metrics already in @path, so that a batch
+     * of runs accumulates into one file; otherwise @path is also replaced every @interval_seconds.
+     */
+    static void start(const std::string& path, unsigned interval_seconds = 0);
+    /* Add @n to @counter. */
+    static void add(Counter counter, uint64_t n = 1);
+    /* Record that @phase took @nanoseconds. */
+    static void observePhase(Core::Phase phase, uint64_t nanoseconds);
+    /* Record that computing a KDF took @nanoseconds. */
+    static void observeKdf(uint64_t nanoseconds);
+    /* Export to the path given to start(). Return false on failure. */
+    static bool dump(void);
+    static bool enabled(void)
+     {
+      return is_enabled.load(std::memory_order_relaxed);
+     }
+   private:
+    static std::atomic<bool> is_enabled;
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,47 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_NUMA_HH
+#define FOURCRYPT_NUMA_HH
+#include <SSC/Macro.h>
+
+namespace fourcrypt
+ {
+  /* Return a bitmask of the online NUMA nodes, as listed by sysfs.
+   * Return 0 when the topology cannot be determined. */
+  uint64_t
+  numa_online_nodes(void);
+
+  /* A thread's memory policy, as saved by numa_interleave_begin(). */
+  struct NumaPolicy
+   {
+    int           mode  {0};
+    unsigned long nodes {0};
+   };
+
+  /* When there is more than one online NUMA node and the calling thread has the default memory
+   * policy, save that policy at @saved, set the policy to interleave subsequently allocated pages
+   * across all the nodes and return true. Threads spawned afterward inherit the policy.
+   * Otherwise do nothing and return false; in particular an inherited policy such as
+   * `numactl --membind` is left in force. */
+  bool
+  numa_interleave_begin(NumaPolicy* saved);
+
+  /* Restore the memory policy of the calling thread that numa_interleave_begin() saved at @saved. */
+  void
+  numa_interleave_end(const NumaPolicy& saved);
+ }
+#endif
@@ -0,0 +1,61 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_PERFCOUNTERS_HH
+#define FOURCRYPT_PERFCOUNTERS_HH
+// SSC
+#include <SSC/Macro.h>
+// C++ STL
+#include <array>
+
+namespace fourcrypt
+ {
+  /* Hardware and software performance counters of the calling thread and the threads it spawns
+   * afterward (e.g. the KDF threads), opened with perf_event_open(2) on Linux. A spawned thread's
+   * counts only show up once it exits, so threads that outlive a measurement, such as the workers of
+   * an Executor, aren't reflected in it.
+   * Counters that the kernel refuses to open, because of perf_event_paranoid, a missing PMU inside a
+   * virtual machine or an unsupported event, are simply reported as unavailable.
+   */
+  class PerfCounters
+   {
+   public:
+    enum Counter
+     {
+      CYCLES, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, PAGE_FAULTS, COUNT
+     };
+    using Values_t = std::array<uint64_t, COUNT>;
+
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    /* Open and start every counter that can be opened. Return true if at least one was. */
+    bool        open(void);
+    void        close(void);
+    bool        available(Counter c) const;
+    bool        anyAvailable(void) const;
+    /* Store the current value of each counter at @values, scaled up for any time it was multiplexed
+     * off the PMU. Unavailable counters read as 0. */
+    void        read(Values_t& values) const;
+    /* Return the short name of @c, e.g. "llc_misses". */
+    static const char* name(Counter c);
+   private:
+    std::array<int, COUNT> fds {-1, -1, -1, -1, -1};
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,55 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_PROBES_HH
+#define FOURCRYPT_PROBES_HH
+/* USDT (user-level statically defined tracing) probes for bpftrace, perf, SystemTap and the like,
+ * e.g. `bpftrace -e 'usdt:./4crypt:fourcrypt:ctr_tile { @bytes = sum(arg1); }'`.
+ * Each probe compiles to a single nop plus a note in the ELF file, so an untraced probe costs nothing
+ * beyond keeping its arguments in registers. Probes are compiled out entirely without <sys/sdt.h>,
+ * or when FOURCRYPT_NO_USDT is defined (the USDT CMake option).
+ *
+ * Provider "fourcrypt":
+ *   kdf_entry(memory_low, memory_high, iterations, thread_count, batch_size, phi)
+ *   kdf_return(error, batch_size)              error is a Core SSC_CodeError_t; 0 on success.
+ *   map_entry(input_bytes, output_bytes)
+ *   map_return(error)
+ *   sync_entry(input_bytes, output_bytes)
+ *   sync_return(error)
+ *   encipher_entry(plaintext_bytes, padding_bytes) / encipher_return(plaintext_bytes, padding_bytes)
+ *   decipher_entry(bytes) / decipher_return(bytes)
+ *   ctr_tile(keystream_index, bytes)           Once per CTR_TILE_BYTES tile of the counter mode passes.
+ *   mac_entry(bytes) / mac_return(bytes)
+ *   mac_verify_entry(bytes) / mac_verify_return(bytes, matched)
+ */
+#if !defined(FOURCRYPT_NO_USDT) && defined(__has_include)
+ #if __has_include(<sys/sdt.h>)
+  #include <sys/sdt.h>
+  #define FOURCRYPT_HAVE_USDT
+ #endif
+#endif
+
+#ifdef FOURCRYPT_HAVE_USDT
+ #define FOURCRYPT_PROBE1(name, a)                DTRACE_PROBE1(fourcrypt, name, a)
+ #define FOURCRYPT_PROBE2(name, a, b)             DTRACE_PROBE2(fourcrypt, name, a, b)
+ #define FOURCRYPT_PROBE6(name, a, b, c, d, e, f) DTRACE_PROBE6(fourcrypt, name, a, b, c, d, e, f)
+#else
+ #define FOURCRYPT_PROBE1(name, a)                ((void)0)
+ #define FOURCRYPT_PROBE2(name, a, b)             ((void)0)
+ #define FOURCRYPT_PROBE6(name, a, b, c, d, e, f) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_RESOURCES_HH
+#define FOURCRYPT_RESOURCES_HH
+// SSC
+#include <SSC/Macro.h>
+// C++ C Lib
+#include <cstdio>
+
+namespace fourcrypt
+ {
+  /* The memory and processors this process may actually use. Inside containers the host's figures
+   * overstate both, so cgroup (v2, falling back to v1) limits and the scheduler affinity mask
+   * are taken into account as well.
+   */
+  class Resources
+   {
+   public:
+    uint64_t processors            {1};   // Online processors, as reported by the OS.
+    uint64_t affinity_processors   {0};   // Processors this process may be scheduled on; 0 if unknown.
+    double   cpu_quota             {0.0}; // Processors' worth of CPU time allowed by cgroups; 0 if unlimited.
+    uint64_t host_memory_available {0};   // Memory available on the host; 0 if unknown.
+    uint64_t cgroup_memory_limit   {0};   // The tightest cgroup memory limit; 0 if unlimited.
+    uint64_t cgroup_memory_usage   {0};   // Non-reclaimable memory charged against that limit.
+    int      cgroup_version        {0};   // 1 or 2; 0 if no cgroup controllers were found.
+
+    /* Detect the resources of the calling process. */
+    static Resources detect(void);
+    /* Return how many bytes may be allocated without exceeding the host's available memory or a
+     * cgroup limit. Return 0 if neither is known. */
+    uint64_t availableMemory(void) const;
+    /* Return how many processors' worth of threads may usefully run at once. Never returns 0. */
+    uint64_t usableProcessors(void) const;
+    /* Print a human-readable description of the detected resources to @f. */
+    void     print(std::FILE* f) const;
+   };
+ } // ! namespace fourcrypt
+#endif
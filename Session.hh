@@ -0,0 +1,110 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_SESSION_HH
+#define FOURCRYPT_SESSION_HH
+
+// Local
+#include "Core.hh"
+// C++ STL
+#include <mutex>
+#include <semaphore>
+#include <span>
+#include <string>
+
+namespace fourcrypt
+ {
+  class MemoryBudget;
+
+  /* Executes any number of encrypt and decrypt jobs, one after another or concurrently from
+   * different threads. Each job runs on a Core of its own (or on one the caller lends for
+   * the duration of the job), whose PlainOldData is reset and whose CSPRNG is reseeded from the
+   * operating system before the job starts, and wiped again when it ends. Jobs therefore never share keys,
+   * passwords or generator state. Concurrent jobs take turns computing their KDFs, because each
+   * KDF plans its memory usage against what's currently available.
+   */
+  class Session
+   {
+   public:
+    // Predefined KDF parameter sets, see Core::PlainOldData::set_fast() and friends.
+    enum class Preset
+     {
+      NONE, FAST, NORMAL, STRONG
+     };
+    /* Everything one job needs. The password is held in a fixed buffer that is wiped on destruction. */
+    struct Job
+     {
+      Core::ExeMode   mode              {Core::ExeMode::ENCRYPT};
+      std::string     input             {};
+      std::string     output            {};    // Leave empty to derive it from @input, like the command-line does.
+      Preset          preset            {Preset::NONE}; // Applied after the KDF parameters below.
+      uint64_t        thread_count      {1};
+      uint64_t        thread_batch_size {0};
+      uint64_t        padding_size      {0};
+      Core::PadMode   padding_mode      {Core::PadMode::ADD};
+      uint8_t         memory_low        {Core::MEM_DEFAULT};
+      uint8_t         memory_high       {Core::MEM_DEFAULT};
+      uint8_t         iterations        {1};
+      SSC_BitFlag8_t  flags             {0};
+      Stats*          stats             {nullptr}; // Accumulate per-phase statistics here, if non-nullptr.
+
+      /* Copy the @size byte password at @pw. Return false if it's empty or longer than Core::MAX_PW_BYTES. */
+      bool setPassword(const void* pw, size_t size);
+      void clearPassword();
+      bool hasPassword() const { return this->password_size != 0; }
+      ~Job();
+     private:
+      friend class Session;
+      uint8_t         password_buffer [Core::PW_BUFFER_BYTES] {};
+      uint64_t        password_size   {0};
+     };
+    struct Result
+     {
+      SSC_CodeError_t code {Core::ERROR_NONE};
+      Core::ErrType   type {Core::ErrType::CORE};
+      Core::InOutDir  dir  {Core::InOutDir::NONE};
+     };
+
+    /* Run @job to completion on a Core of its own. */
+    Result run(const Job& job);
+    /* Run @job to completion on @core, so that the caller may poll @core's progress from other
+     * threads meanwhile. @core must not be running another job.
+     */
+    Result run(const Job& job, Core& core, Core::StatusCallback_f* status_callback = nullptr, void* scb_data = nullptr);
+    /* Run @job on @core from @input into @output instead of between files, see Core::encryptBuffer()
+     * and Core::decryptBuffer(). @job's mode must be ENCRYPT or DECRYPT; its filenames are ignored.
+     */
+    Result runBuffer(const Job& job, Core& core, std::span<uint8_t> output, std::span<const uint8_t> input, uint64_t* output_size);
+    /* Admit the KDFs of subsequent jobs against @budget, so that several may run at once as long as
+     * their memory fits, instead of one at a time. Pass nullptr to return to taking turns.
+     * Set it before running jobs, not while they run. */
+    void   setMemoryBudget(MemoryBudget* budget);
+    Session() = default;
+    /* Wait for any KDF that a cancelled job abandoned, since it still holds this session's gate. */
+    ~Session();
+   private:
+    std::binary_semaphore kdf_gate      {1};
+    MemoryBudget*         memory_budget {nullptr};
+
+    /* Copy @job into @pod, which must have been freshly reset. */
+    static void configure(const Job& job, Core::PlainOldData& pod);
+    /* Reset @core and configure it for @job. */
+    void        begin(const Job& job, Core& core);
+    /* Detach @core from this session and wipe what @job left in it. */
+    void        end(Core& core);
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,75 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_STATS_HH
+#define FOURCRYPT_STATS_HH
+
+// Local
+#include "Core.hh"
+#include "PerfCounters.hh"
+// C++ STL
+#include <array>
+#include <chrono>
+// C++ C Lib
+#include <cstdio>
+
+namespace fourcrypt
+ {
+  /* Wall-clock time and bytes processed per Core::Phase, accumulated over one or more operations,
+   * and optionally the deltas of a set of PerfCounters across each phase.
+   * Attach to a Core with Core::setStats().
+   */
+  class Stats
+   {
+   public:
+    using Phase_t = Core::Phase;
+    using Clock_t = std::chrono::steady_clock;
+    static constexpr int NUM_PHASES {static_cast<int>(Phase_t::COUNT)};
+
+    struct Entry
+     {
+      uint64_t          nanoseconds {0}; // Total time spent in the phase.
+      uint64_t          bytes       {0}; // Total bytes processed in the phase.
+      uint64_t          count       {0}; // How many times the phase was entered.
+      Clock_t::time_point start     {};
+      PerfCounters::Values_t counters       {}; // Total counter deltas over the phase.
+      PerfCounters::Values_t start_counters {};
+     };
+
+    /* Also accumulate the deltas of @pc per phase. Pass nullptr to stop. */
+    void     setCounters(const PerfCounters* pc);
+    /* Start timing @phase. */
+    void     begin(Phase_t phase);
+    /* Stop timing @phase and account @bytes to it. */
+    void     end(Phase_t phase, uint64_t bytes);
+    const Entry& get(Phase_t phase) const;
+    /* Return the total time of all phases, in nanoseconds. */
+    uint64_t totalNanoseconds(void) const;
+    /* Return the peak resident set size of this process in bytes, or 0 if unknown. */
+    static uint64_t peakResidentBytes(void);
+    /* Print every phase that was entered at least once to @f, formatted as @format. */
+    void     print(std::FILE* f, Core::ReportFormat format) const;
+   private:
+    std::array<Entry, NUM_PHASES> entries {};
+    const PerfCounters*           perf_counters {nullptr};
+
+    bool     haveCounters(void) const;
+    void     printText(std::FILE* f) const;
+    void     printTextCounters(std::FILE* f, const Entry& e) const;
+    void     printJson(std::FILE* f) const;
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -0,0 +1,62 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FOURCRYPT_TRACE_HH
+#define FOURCRYPT_TRACE_HH
+// SSC
+#include <SSC/Macro.h>
+// C++ STL
+#include <atomic>
+#include <string>
+
+namespace fourcrypt
+ {
+  /* A process-wide timeline of begin/end events, exported in the Chrome Trace Event format for
+   * chrome://tracing or https://ui.perfetto.dev.
+   *
+   * Each thread records into its own fixed-size ring buffer without locking; when a ring is full the
+   * oldest events are overwritten. A thread takes a lock only once, to register its ring, the first
+   * time it records an event. Event names and categories must be string literals, or otherwise
+   * outlive the trace. While no trace is started, recording costs one relaxed atomic load.
+   */
+  class Trace
+   {
+   public:
+    static constexpr size_t EVENTS_PER_THREAD {size_t{1} << 16}; // Must be a power of 2.
+    static_assert((EVENTS_PER_THREAD & (EVENTS_PER_THREAD - 1)) == 0);
+
+    /* Start recording, and write the trace to @path when the process exits. */
+    static void start(const std::string& path);
+    /* Record the beginning of the span @name, in @category, on the calling thread. */
+    static void begin(const char* name, const char* category, uint64_t arg = 0);
+    /* Record the end of the span @name, which must be the most recently begun open span of this thread. */
+    static void end(const char* name, const char* category, uint64_t arg = 0);
+    /* Name the calling thread in the exported trace. */
+    static void setThreadName(const char* name);
+    /* Write every recorded event to the path given to start(). Return false on failure.
+     * Recording threads should be quiescent. */
+    static bool dump(void);
+    static bool enabled(void)
+     {
+      return is_enabled.load(std::memory_order_relaxed);
+     }
+   private:
+    static std::atomic<bool> is_enabled;
+
+    static void record(char type, const char* name, const char* category, uint64_t arg);
+   };
+ } // ! namespace fourcrypt
+#endif
@@ -17,6 +17,7 @@
 #ifndef FOURCRYPT_UTIL_HH
 #define FOURCRYPT_UTIL_HH
 #include <SSC/Macro.h>
+#include <string>
 #define R_ SSC_RESTRICT
 
 namespace fourcrypt
@@ -29,6 +30,22 @@ namespace fourcrypt
 
   uint64_t
   parse_integer(const char* R_ cstr, const size_t len);
+
+  /* Parse a byte count such as "4096", "64K", "512M" or "2G", exactly; not rounded to a power of 2. */
+  uint64_t
+  parse_bytes(const char* R_ cstr, const size_t len);
+
+  /* Return the name of this host, or "localhost" if it cannot be determined. */
+  std::string
+  get_hostname(void);
+
+  /* Return the model name of this host's processor with whitespace replaced by '_', or "unknown". */
+  std::string
+  get_cpu_model(void);
+
+  /* Return the physical memory of this host in bytes, or 0 if it cannot be determined. */
+  uint64_t
+  get_total_memory(void);
  }
 #undef R_
 #endif
@@ -0,0 +1,175 @@
+/* *
+ * 4crypt - Memory-Hard Symmetric File Encryption Program
+ * Copyright (C) 2025 Stuart Calder
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* The C interface of libfourcrypt-c, for embedding 4crypt in programs that can't use the C++ Core
+ * directly, e.g. through foreign function interfaces. Every type is opaque or a plain C type, and
+ * the ABI only changes along with FOURCRYPT_ABI_VERSION, which is also the shared library's SONAME version.
+ *
+ * Functions returning int return FOURCRYPT_OK (0) on success and a negative fourcrypt_error otherwise.
+ * Sessions are thread-safe; options must not be modified while a job that uses them is running.
+ */
+#ifndef FOURCRYPT_H
+#define FOURCRYPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+ #if defined(FOURCRYPT_BUILDING_CAPI)
+  #define FOURCRYPT_API __declspec(dllexport)
+ #else
+  #define FOURCRYPT_API __declspec(dllimport)
+ #endif
+#elif defined(__GNUC__)
+ #define FOURCRYPT_API __attribute__((visibility("default")))
+#else
+ #define FOURCRYPT_API
+#endif
+
+#define FOURCRYPT_ABI_VERSION 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The values below FOURCRYPT_ERROR_INVALID_ARGUMENT equal Core's error codes. */
+typedef enum fourcrypt_error
+{
+  FOURCRYPT_OK                               =   0,
+  FOURCRYPT_ERROR_NO_INPUT_FILENAME          =  -1,
+  FOURCRYPT_ERROR_NO_OUTPUT_FILENAME         =  -2,
+  FOURCRYPT_ERROR_INPUT_MEMMAP_FAILED        =  -3,
+  FOURCRYPT_ERROR_OUTPUT_MEMMAP_FAILED       =  -4,
+  FOURCRYPT_ERROR_GETTING_INPUT_FILESIZE     =  -5,
+  FOURCRYPT_ERROR_INPUT_FILESIZE_TOO_SMALL   =  -6,
+  FOURCRYPT_ERROR_INVALID_4CRYPT_FILE        =  -7,
+  FOURCRYPT_ERROR_INPUT_SIZE_MISMATCH        =  -8,
+  FOURCRYPT_ERROR_RESERVED_BYTES_USED        =  -9,
+  FOURCRYPT_ERROR_OUTPUT_FILE_EXISTS         = -10,
+  FOURCRYPT_ERROR_MAC_VALIDATION_FAILED      = -11,
+  FOURCRYPT_ERROR_KDF_FAILED                 = -12,
+  FOURCRYPT_ERROR_METADATA_VALIDATION_FAILED = -13,
+  FOURCRYPT_ERROR_CANCELLED                  = -14,
+  FOURCRYPT_ERROR_BUFFER_TOO_SMALL           = -15,
+  FOURCRYPT_ERROR_INVALID_PADDING            = -16,
+  FOURCRYPT_ERROR_INVALID_ARGUMENT           = -100, /* A NULL handle, or an out of range parameter. */
+  FOURCRYPT_ERROR_OUT_OF_MEMORY              = -101,
+  FOURCRYPT_ERROR_IO                         = -102, /* Reading, writing, mapping or sizing a file descriptor failed. */
+  FOURCRYPT_ERROR_UNSUPPORTED                = -103  /* Not available on this platform. */
+} fourcrypt_error;
+
+/* The stages of a job, in order. */
+typedef enum fourcrypt_phase
+{
+  FOURCRYPT_PHASE_MAP_FILES,
+  FOURCRYPT_PHASE_PASSWORD,
+  FOURCRYPT_PHASE_RANDOM,
+  FOURCRYPT_PHASE_KDF,
+  FOURCRYPT_PHASE_HEADER,
+  FOURCRYPT_PHASE_CIPHER,
+  FOURCRYPT_PHASE_MAC,
+  FOURCRYPT_PHASE_SYNC,
+  FOURCRYPT_PHASE_UNMAP_FILES
+} fourcrypt_phase;
+
+typedef enum fourcrypt_preset
+{
+  FOURCRYPT_PRESET_NONE,   /* Use the KDF parameters set on the options. */
+  FOURCRYPT_PRESET_FAST,
+  FOURCRYPT_PRESET_NORMAL,
+  FOURCRYPT_PRESET_STRONG  /* Calibrated to this host; may take a while the first time. */
+} fourcrypt_preset;
+
+typedef enum fourcrypt_pad_mode
+{
+  FOURCRYPT_PAD_ADD,    /* Add this many bytes of padding. */
+  FOURCRYPT_PAD_TARGET, /* Pad the output to this size. */
+  FOURCRYPT_PAD_AS_IF   /* Pad as if the plaintext were this size. */
+} fourcrypt_pad_mode;
+
+typedef struct fourcrypt_session fourcrypt_session;
+typedef struct fourcrypt_options fourcrypt_options;
+
+/* Called about every 100 milliseconds from a library thread while a job runs.
+ * @bytes_done and @bytes_total cover the cipher and MAC passes together and stay 0 until the KDF is done.
+ */
+typedef void fourcrypt_progress_fn(void* user_data, fourcrypt_phase phase, uint64_t bytes_done, uint64_t bytes_total);
+/* Called about every 10 milliseconds from a library thread while a job runs. Return nonzero to cancel the job,
+ * which then fails with FOURCRYPT_ERROR_CANCELLED within tens of milliseconds, unless it finishes first;
+ * only computing the MAC can't be interrupted. Partial outputs are wiped or emptied.
+ */
+typedef int  fourcrypt_cancel_fn(void* user_data);
+
+/* Return the FOURCRYPT_ABI_VERSION the library was built with. */
+FOURCRYPT_API int         fourcrypt_abi_version(void);
+/* Return a static, human readable description of @error. Never returns NULL. */
+FOURCRYPT_API const char* fourcrypt_strerror(int error);
+
+/* Return a new session, or NULL if out of memory. Jobs of one session may run concurrently from
+ * any number of threads; their key derivations take turns, so they don't compete for memory.
+ */
+FOURCRYPT_API fourcrypt_session* fourcrypt_session_new(void);
+FOURCRYPT_API void               fourcrypt_session_free(fourcrypt_session* session);
+
+/* Return new options holding the defaults, or NULL if out of memory. Freeing the options wipes the password. */
+FOURCRYPT_API fourcrypt_options* fourcrypt_options_new(void);
+FOURCRYPT_API void               fourcrypt_options_free(fourcrypt_options* options);
+/* Copy the password; 1 to 125 bytes. Jobs without a password fail with FOURCRYPT_ERROR_INVALID_ARGUMENT. */
+FOURCRYPT_API int fourcrypt_options_set_password(fourcrypt_options* options, const void* password, size_t size);
+FOURCRYPT_API int fourcrypt_options_set_preset(fourcrypt_options* options, fourcrypt_preset preset);
+/* Bytes of memory per KDF thread: a power of 2 of at least 64. */
+FOURCRYPT_API int fourcrypt_options_set_memory(fourcrypt_options* options, uint64_t bytes);
+/* KDF iterations per thread, 1 to 255. */
+FOURCRYPT_API int fourcrypt_options_set_iterations(fourcrypt_options* options, unsigned iterations);
+/* KDF threads, and how many of them compute at once (0 for all). */
+FOURCRYPT_API int fourcrypt_options_set_threads(fourcrypt_options* options, uint64_t threads, uint64_t batch_size);
+FOURCRYPT_API int fourcrypt_options_set_phi(fourcrypt_options* options, int enable);
+FOURCRYPT_API int fourcrypt_options_set_padding(fourcrypt_options* options, uint64_t size, fourcrypt_pad_mode mode);
+FOURCRYPT_API int fourcrypt_options_set_progress_callback(fourcrypt_options* options, fourcrypt_progress_fn* fn, void* user_data);
+FOURCRYPT_API int fourcrypt_options_set_cancel_callback(fourcrypt_options* options, fourcrypt_cancel_fn* fn, void* user_data);
+
+/* Return the exact size of the output of encrypting @plaintext_size bytes with @options' padding,
+ * or 0 if the padding can't be honored.
+ */
+FOURCRYPT_API uint64_t fourcrypt_encrypted_size(const fourcrypt_options* options, uint64_t plaintext_size);
+/* Return an upper bound on the plaintext size of a @ciphertext_size byte 4crypt file, or 0 if it's too small. */
+FOURCRYPT_API uint64_t fourcrypt_decrypted_size_bound(uint64_t ciphertext_size);
+
+/* Encrypt or decrypt @input_size bytes at @input into @output, which holds @output_capacity bytes.
+ * Store the size of the output at @output_size; when encrypting also on FOURCRYPT_ERROR_BUFFER_TOO_SMALL.
+ * Nothing is written to @output by decryption unless the input authenticates.
+ */
+FOURCRYPT_API int fourcrypt_encrypt_buffer(
+ fourcrypt_session* session, const fourcrypt_options* options,
+ const void* input, size_t input_size, void* output, size_t output_capacity, size_t* output_size);
+FOURCRYPT_API int fourcrypt_decrypt_buffer(
+ fourcrypt_session* session, const fourcrypt_options* options,
+ const void* input, size_t input_size, void* output, size_t output_capacity, size_t* output_size);
+
+/* Encrypt or decrypt everything readable from @input_fd and write the result to @output_fd.
+ * Regular files are memory-mapped; pipes and sockets are read until end of file and written in full.
+ * As with read() and write(), both descriptors' current offsets are honored and advanced, and an output
+ * opened with O_APPEND is appended to. @output_fd must be writable, and must also be readable if it
+ * refers to a regular file, which is truncated at the end of the output; if the job fails it's truncated
+ * back to where the output would have begun. POSIX only; elsewhere these return FOURCRYPT_ERROR_UNSUPPORTED.
+ */
+FOURCRYPT_API int fourcrypt_encrypt_fd(fourcrypt_session* session, const fourcrypt_options* options, int input_fd, int output_fd);
+FOURCRYPT_API int fourcrypt_decrypt_fd(fourcrypt_session* session, const fourcrypt_options* options, int input_fd, int output_fd);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+#endif /* ! FOURCRYPT_H */